@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Plgrin Marius
+//! \copyright The MIT License (MIT)
+//! \date 2022-2023
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Diskon/Core/CoreTypes.hpp>
+
+namespace dsk
+{
+	/*
+	* Same kind of lookup as LookupMultitable - one level per byte of the key - but each level only stores its used entries:
+	* a 256-bit occupancy bitmap tells which bytes are present, and the rank of a byte in the bitmap is its index in the
+	* packed array of children. Values up to 32 bytes are stored inline in the last level, so pointers to them are
+	* invalidated by insertions, larger values are allocated separately and keep their address.
+	*/
+	template<typename TKey, typename TValue>
+	class CompactLookupMultitable
+	{
+		public:
+
+			constexpr CompactLookupMultitable() = default;
+			constexpr CompactLookupMultitable(const CompactLookupMultitable<TKey, TValue>& table) = default;
+			constexpr CompactLookupMultitable(CompactLookupMultitable<TKey, TValue>&& table) = default;
+
+			constexpr CompactLookupMultitable<TKey, TValue>& operator=(const CompactLookupMultitable<TKey, TValue>& table) = default;
+			constexpr CompactLookupMultitable<TKey, TValue>& operator=(CompactLookupMultitable<TKey, TValue>&& table) = default;
+
+			constexpr bool empty() const;
+			constexpr uint64_t size() const;
+
+			constexpr void clear();
+			constexpr bool insertOrAssign(const TKey& key, const TValue& value);
+			template<typename... TArgs> constexpr bool emplace(const TKey& key, TArgs&&... args);
+
+			constexpr TValue& at(const TKey& key);
+			constexpr const TValue& at(const TKey& key) const;
+			constexpr TValue& operator[](const TKey& key);
+			constexpr TValue* find(const TKey& key);
+			constexpr const TValue* find(const TKey& key) const;
+			constexpr bool contains(const TKey& key) const;
+
+			constexpr ~CompactLookupMultitable() = default;
+
+		private:
+
+			static constexpr uint64_t _keySize = sizeof(TKey);
+			static constexpr bool _inlineValues = sizeof(TValue) <= 32;
+
+			struct InlineValue
+			{
+				template<typename... TArgs> constexpr InlineValue(std::in_place_t, TArgs&&... args);
+
+				constexpr TValue& get();
+				constexpr const TValue& get() const;
+
+				TValue value;
+			};
+
+			struct BoxedValue
+			{
+				template<typename... TArgs> constexpr BoxedValue(std::in_place_t, TArgs&&... args);
+				constexpr BoxedValue(const BoxedValue& boxedValue);
+				constexpr BoxedValue(BoxedValue&& boxedValue) = default;
+
+				constexpr BoxedValue& operator=(const BoxedValue& boxedValue);
+				constexpr BoxedValue& operator=(BoxedValue&& boxedValue) = default;
+
+				constexpr TValue& get();
+				constexpr const TValue& get() const;
+
+				std::unique_ptr<TValue> value;
+			};
+
+			using Value = std::conditional_t<_inlineValues, InlineValue, BoxedValue>;
+
+			template<uint64_t Level>
+			struct Node
+			{
+				using Child = std::conditional_t<Level == _keySize, Value, Node<Level + 1>>;
+
+				constexpr bool contains(uint8_t byte) const;
+				constexpr uint16_t indexOf(uint8_t byte) const;
+
+				uint64_t bitmap[4] = {};
+				std::vector<Child> children;
+			};
+
+			template<uint64_t Level = 1> static constexpr const Value* _find(const Node<Level>& node, const uint8_t* address);
+			template<uint64_t Level = 1, typename... TArgs> static constexpr Value& _findOrEmplace(Node<Level>& node, const uint8_t* address, bool& inserted, TArgs&&... args);
+			template<uint64_t Level = 1> static constexpr uint64_t _size(const Node<Level>& node);
+
+			Node<1> _root;
+	};
+}
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Plgrin Marius
+//! \copyright The MIT License (MIT)
+//! \date 2022-2023
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Diskon/Core/CoreTypes.hpp>
+
+namespace dsk
+{
+	namespace _dsk
+	{
+		constexpr uint64_t constLookupHash(uint64_t key, uint64_t seed);
+		constexpr uint64_t constLookupHash(std::string_view key, uint64_t seed);
+		template<typename TKey> requires std::is_integral_v<TKey> || std::is_enum_v<TKey> constexpr uint64_t constLookupHash(TKey key, uint64_t seed);
+	}
+
+	/*
+	* Immutable map built at compile time from a fixed list of entries, to be stored in a constexpr variable.
+	* Integral keys spanning a small range are stored in a dense array indexed by key, other keys use a perfect hash
+	* (hash and displace: the keys are first hashed in buckets, then each bucket gets the seed that sends its keys to
+	* free slots). A lookup is at most two hashes and one key comparison.
+	*/
+	template<typename TKey, typename TValue, uint64_t Size>
+	class ConstLookupTable
+	{
+		public:
+
+			using Entry = std::pair<TKey, TValue>;
+
+			constexpr ConstLookupTable(const Entry (&entries)[Size]);
+			constexpr ConstLookupTable(const ConstLookupTable<TKey, TValue, Size>& table) = default;
+			constexpr ConstLookupTable(ConstLookupTable<TKey, TValue, Size>&& table) = default;
+
+			constexpr ConstLookupTable<TKey, TValue, Size>& operator=(const ConstLookupTable<TKey, TValue, Size>& table) = default;
+			constexpr ConstLookupTable<TKey, TValue, Size>& operator=(ConstLookupTable<TKey, TValue, Size>&& table) = default;
+
+			constexpr uint64_t size() const;
+
+			constexpr const TValue& at(const TKey& key) const;
+			constexpr const TValue* find(const TKey& key) const;
+			constexpr bool contains(const TKey& key) const;
+
+			constexpr ~ConstLookupTable() = default;
+
+		private:
+
+			struct Slot
+			{
+				TKey key = {};
+				TValue value = {};
+				bool used = false;
+			};
+
+			static_assert(Size != 0);
+
+			static constexpr uint64_t _tableSize = std::bit_ceil(2 * Size);
+			static constexpr uint64_t _tableFilter = _tableSize - 1;
+			static constexpr uint64_t _bucketCount = Size;
+			static constexpr uint64_t _maxSeed = 1 << 20;
+
+			constexpr uint64_t _slotIndex(const TKey& key) const;
+
+			std::array<Slot, _tableSize> _slots;
+			std::array<uint32_t, _bucketCount> _seeds;
+			bool _isDense;
+			uint64_t _minKey;
+	};
+
+	template<typename TKey, typename TValue, uint64_t Size> constexpr ConstLookupTable<TKey, TValue, Size> makeConstLookupTable(const std::pair<TKey, TValue> (&entries)[Size]);
+}
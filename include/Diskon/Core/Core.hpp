@@ -15,5 +15,7 @@
 #include <Diskon/Core/templates/IntSat.hpp>
 #include <Diskon/Core/templates/Hash.hpp>
 #include <Diskon/Core/templates/LookupMultitable.hpp>
+#include <Diskon/Core/templates/CompactLookupMultitable.hpp>
+#include <Diskon/Core/templates/ConstLookupTable.hpp>
 #include <Diskon/Core/templates/Huffman.hpp>
 #include <Diskon/Core/templates/Stream.hpp>
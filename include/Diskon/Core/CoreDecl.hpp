@@ -15,5 +15,7 @@
 #include <Diskon/Core/IntSat.hpp>
 #include <Diskon/Core/Hash.hpp>
 #include <Diskon/Core/LookupMultitable.hpp>
+#include <Diskon/Core/CompactLookupMultitable.hpp>
+#include <Diskon/Core/ConstLookupTable.hpp>
 #include <Diskon/Core/Huffman.hpp>
 #include <Diskon/Core/Stream.hpp>
@@ -17,10 +17,12 @@
 #include <cstdio>
 #include <cstring>
 #include <format>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -66,8 +68,9 @@ namespace dsk
 	template<typename TKey, typename TValue> class LookupMultitable;
 	template<typename TKey, typename TValue> class LookupMultitableConstIterator;
 	template<typename TKey, typename TValue> class LookupMultitableIterator;
+	template<typename TKey, typename TValue> class CompactLookupMultitable;
+	template<typename TKey, typename TValue, uint64_t Size> class ConstLookupTable;
 
-	template<typename TSymbol> struct HuffmanTableEntry;
 	template<typename TSymbol, std::endian BitEndianness> class HuffmanDecoder;
 	template<typename TSymbol, std::endian BitEndianness> class HuffmanEncoder;
 
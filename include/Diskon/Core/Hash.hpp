@@ -25,18 +25,34 @@ namespace dsk
 				constexpr Crc();
 				constexpr TValue operator()(const void* src, uint64_t size, TValue crc = 0) const;
 
+				// Get the CRC of the concatenation of two parts from their CRCs, nextSize being the size of the second part
+				constexpr TValue combine(TValue crc, TValue nextCrc, uint64_t nextSize) const;
+
 			private:
 
+				// Product modulo the polynomial, in the reflected representation. a cannot be 0.
+				static constexpr TValue _multiply(TValue a, TValue b);
+
 				TValue _table[256];
 		};
 
 		// Fletcher/Adler
 
 		template<typename TValue, typename THalf, TValue Modulus>
-		struct Fletcher
+		class Fletcher
 		{
-			constexpr Fletcher() = default;
-			constexpr TValue operator()(const void* src, uint64_t size, TValue initialValue = 1) const;
+			public:
+
+				constexpr Fletcher() = default;
+				constexpr TValue operator()(const void* src, uint64_t size, TValue initialValue = 1) const;
+
+				// Get the checksum of the concatenation of two parts from their checksums, nextSize being the size of the second part
+				constexpr TValue combine(TValue value, TValue nextValue, uint64_t nextSize, TValue initialValue = 1) const;
+
+			private:
+
+				// Number of words summed in 64 bits before the sums can overflow, the modulo being taken once per run of words
+				static constexpr uint64_t _computeRunSize();
 		};
 	}
 }
@@ -11,21 +11,34 @@
 
 namespace dsk
 {
-	template<typename TSymbol>
-	struct HuffmanTableEntry
+	namespace _dsk
 	{
-		uint8_t bitCount = 0;
-		union
-		{
-			HuffmanTableEntry<TSymbol>* next = nullptr;
-			TSymbol symbol;
-		};
-
-		static HuffmanTableEntry<TSymbol>* createTable();
-		static bool addSymbol(HuffmanTableEntry<TSymbol>* table, const TSymbol& symbol, uint64_t codeLength, uint8_t* code = nullptr);
-		static void swapEndianness(HuffmanTableEntry<TSymbol>* table);
-		static void destroyTable(HuffmanTableEntry<TSymbol>* table);
-	};
+		/*
+		* Assign canonical codes to symbols from their code lengths: shorter codes come first, and codes of the same
+		* length are assigned in the order of the symbols. A code length of 0 means the symbol is not used.
+		* Codes are written MSB first in the lowest bits of codes[i]. Returns false if the code lengths are
+		* over-subscribed (incomplete codes are allowed).
+		*/
+		constexpr bool huffmanCodeLengthsToCodes(const uint64_t* codeLengths, uint64_t* codes, uint64_t symbolCount);
+
+		// Reverse the order of the codeLength lowest bits of code, to get the code in the order it is read in little endian
+		constexpr uint64_t huffmanReverseCode(uint64_t code, uint8_t codeLength);
+
+		/*
+		* Interleaved streams format: symbols are split in huffmanStreamCount contiguous segments of (symbolCount + 3) / 4
+		* symbols (the last ones may be shorter), each one encoded in its own byte-aligned stream. The streams are preceded
+		* by a jump table holding the byte sizes of the first huffmanStreamCount - 1 streams as 32-bit little endian integers.
+		*/
+		constexpr uint8_t huffmanStreamCount = 4;
+		constexpr uint8_t huffmanJumpTableSize = (huffmanStreamCount - 1) * 4;
+		constexpr uint64_t huffmanStreamSymbolCount(uint64_t symbolCount, uint8_t streamIndex);
+
+		/*
+		* Compute optimal code lengths no longer than maxCodeLength from the occurences of the symbols. A symbol that never
+		* occurs gets a code length of 0. Runs without allocation, scratch must hold 2 * symbolCount values.
+		*/
+		constexpr void huffmanOccurencesToCodeLengths(const uint64_t* occurences, uint64_t* codeLengths, uint64_t symbolCount, uint8_t maxCodeLength, uint64_t* scratch);
+	}
 
 	// TODO: Handle different orders of construction of the tree (1 before 0) ? Is it necessary ?
 
@@ -35,6 +48,7 @@ namespace dsk
 		public:
 
 			static void symbolOccurencesToCodeLengths(const TSymbol* symbols, const uint64_t* symbolOccurences, uint64_t* codeLengths, uint64_t symbolCount);
+			static void symbolOccurencesToCodeLengths(const uint64_t* symbolOccurences, uint64_t* codeLengths, uint64_t symbolCount, uint8_t maxCodeLength, uint64_t* scratch);
 			static void symbolBufferToSymbolOccurences(const TSymbol* symbolBuffer, uint64_t bufferLength, std::vector<TSymbol>& symbols, std::vector<uint64_t>& symbolOccurences);
 
 			HuffmanEncoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount);
@@ -45,20 +59,48 @@ namespace dsk
 			HuffmanEncoder& operator=(HuffmanEncoder&& encoder) = delete;
 
 			template<uint8_t DstOffset = 0> void writeSymbol(const TSymbol& symbol, uint8_t* dst, uint64_t& bytesWritten, uint8_t& bitsWritten) const;
-			void writeSymbol(const TSymbol& symbol, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten);
+			void writeSymbol(const TSymbol& symbol, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten) const;
+
+			/*
+			* Write symbolCount symbols starting at bit dstOffset of dst. The bits of dst before dstOffset are kept.
+			* Small integral alphabets are encoded from a dense code array through a 64-bit accumulator, other alphabets
+			* fall back to writeSymbol.
+			*/
+			void encodeSymbols(const TSymbol* symbols, uint64_t symbolCount, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten) const;
+
+			// Write symbols as interleaved streams (see _dsk::huffmanStreamCount), returns the number of bytes written
+			uint64_t encodeStreams(const TSymbol* symbols, uint64_t symbolCount, uint8_t* dst) const;
+			uint64_t getMaxStreamsSize(uint64_t symbolCount) const;
 
-			~HuffmanEncoder();
+			/*
+			* Get the code of a symbol with its bits in the order they are written: the first bit is the LSB of bits in
+			* little endian, and the MSB of the bitCount lowest bits in big endian. Returns false if the symbol has no code.
+			*/
+			bool getCode(const TSymbol& symbol, uint64_t& bits, uint8_t& bitCount) const;
+
+			~HuffmanEncoder() = default;
 
 		private:
 
 			struct Code
 			{
-				uint8_t* data;
+				uint8_t data[8];
 				uint64_t byteCount;
 				uint8_t bitCount;
 			};
 
-			LookupMultitable<TSymbol, Code> _table;
+			struct DenseCode
+			{
+				uint64_t bits;
+				uint8_t length;
+			};
+
+			static constexpr bool _hasDenseTable = std::is_integral_v<TSymbol> && !std::is_same_v<TSymbol, bool> && sizeof(TSymbol) <= 2;
+			static constexpr uint8_t _maxDenseCodeLength = 32;
+
+			CompactLookupMultitable<TSymbol, Code> _table;
+			std::vector<DenseCode> _denseTable;	// Indexed by the unsigned value of the symbol, empty if not usable
+			uint8_t _maxCodeLength;
 	};
 
 	template<typename TSymbol, std::endian BitEndianness = std::endian::big>
@@ -66,7 +108,7 @@ namespace dsk
 	{
 		public:
 
-			HuffmanDecoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount);
+			HuffmanDecoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount, bool multiSymbolTable = false);
 			HuffmanDecoder(const HuffmanDecoder<TSymbol>& decoder) = delete;
 			HuffmanDecoder(HuffmanDecoder<TSymbol>&& decoder) = delete;
 
@@ -76,10 +118,68 @@ namespace dsk
 			template<uint8_t SrcOffset = 0> bool readSymbol(TSymbol& symbol, const uint8_t* src, uint64_t& bytesRead, uint8_t& bitsRead) const;
 			bool readSymbol(TSymbol& symbol, const uint8_t* src, uint8_t srcOffset, uint64_t& bytesRead, uint8_t& bitsRead) const;
 
-			~HuffmanDecoder();
+			/*
+			* Read up to maxCount symbols starting at bit srcOffset of src, never reading past srcSize bytes. Returns the
+			* number of symbols read, which is less than maxCount if an invalid code is met or if src ends before the next
+			* code does. If the decoder was built with multiSymbolTable, a single lookup can resolve several short codes.
+			*/
+			uint64_t readSymbols(TSymbol* symbols, uint64_t maxCount, const uint8_t* src, uint64_t srcSize, uint8_t srcOffset, uint64_t& bytesRead, uint8_t& bitsRead) const;
+
+			// Read symbolCount symbols written by HuffmanEncoder::encodeStreams, decoding the streams side by side
+			bool readStreams(TSymbol* symbols, uint64_t symbolCount, const uint8_t* src, uint64_t srcSize) const;
+
+			~HuffmanDecoder() = default;
 
 		private:
 
-			HuffmanTableEntry<TSymbol>* _table;
+			/*
+			* The decoding table is a root table indexed by the next _rootBits bits of the stream, followed by subtables
+			* for the codes longer than that. Subtables are packed in the same array right after the root table.
+			* An entry is either a leaf (subtableBits == 0 and bitCount != 0), a link to a subtable (subtableBits != 0),
+			* or an invalid code (both 0).
+			*/
+			struct Entry
+			{
+				union
+				{
+					TSymbol symbol;
+					uint32_t subtableIndex = 0;
+				};
+				uint8_t bitCount = 0;
+				uint8_t subtableBits = 0;
+			};
+
+			struct Code
+			{
+				TSymbol symbol;
+				uint64_t bits;
+				uint8_t length;
+			};
+
+			// Up to _maxMultiSymbols symbols whose codes all fit in the root bits, bitCounts[i] being the bits used by the i+1 first symbols
+			struct MultiEntry
+			{
+				TSymbol symbols[3];
+				uint8_t bitCounts[3];
+				uint8_t symbolCount;
+			};
+
+			static constexpr uint8_t _maxTableBits = 10;
+			static constexpr uint8_t _maxMultiSymbols = 3;
+			static constexpr uint8_t _maxWindowCodeLength = 56;
+
+			static constexpr uint64_t _peekBits(const uint8_t* src, uint64_t bitOffset, uint8_t bitCount);
+			static constexpr uint64_t _peekWindow(uint64_t window, uint8_t bitOffset, uint8_t bitCount);
+			static constexpr uint64_t _loadWindow(const uint8_t* src, uint8_t srcOffset);
+
+			// The table and root bits are passed explicitly so that they are not reloaded after each write of a symbol
+			static const Entry* _readWindowEntry(const Entry* table, uint8_t rootBits, uint64_t window, uint8_t& bitOffset);
+
+			void _fillTable(uint32_t tableIndex, uint8_t tableBits, uint8_t consumedBits, const Code* codes, const Code* codesEnd);
+
+			std::vector<Entry> _table;
+			std::vector<MultiEntry> _multiTable;	// Same indices as the root table, empty if not requested
+			uint8_t _rootBits;
+			uint8_t _maxCodeLength;
 	};
 }
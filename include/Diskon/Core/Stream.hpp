@@ -45,11 +45,22 @@ namespace dsk
 			void bitRead(bool& bit);
 			void bitRead(uint8_t* data, uint64_t bitCount, uint8_t bitOffset = 0);
 
+			/*
+			* Give direct access to the buffered data starting at the cursor, refilling the buffer first if less than
+			* minSize bytes are left in it. size is less than minSize only at the end of the handle. minSize cannot exceed
+			* the keep size. Nothing is consumed: use bitSkip to move the cursor past what was used.
+			*/
+			void bitPeek(const uint8_t*& data, uint64_t& size, uint8_t& bitOffset, uint64_t minSize);
+			void bitSkip(uint64_t bitCount);
+
 			void finishByte();
 
 
 			inline bool eof() const;
 
+			// Number of bits before the cursor since the beginning of the handle
+			inline uint64_t getBitPosition() const;
+
 			constexpr void setByteEndianness(std::endian endianness);
 			constexpr std::endian getByteEndianness() const;
 			constexpr void setBitEndianness(std::endian endianness);
@@ -78,6 +89,8 @@ namespace dsk
 
 			uint8_t* _cursor;
 			uint8_t _bitCursor;
+
+			uint64_t _sizeReadFromHandle;
 			
 			std::endian _byteEndianness;
 			std::endian _bitEndianness;
@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Plgrin Marius
+//! \copyright The MIT License (MIT)
+//! \date 2022-2023
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <Diskon/Core/CoreDecl.hpp>
+
+namespace dsk
+{
+	template<typename TKey, typename TValue>
+	constexpr bool CompactLookupMultitable<TKey, TValue>::empty() const
+	{
+		return _root.children.empty();
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr uint64_t CompactLookupMultitable<TKey, TValue>::size() const
+	{
+		return _size(_root);
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr void CompactLookupMultitable<TKey, TValue>::clear()
+	{
+		_root = Node<1>();
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr bool CompactLookupMultitable<TKey, TValue>::insertOrAssign(const TKey& key, const TValue& value)
+	{
+		bool inserted;
+		Value& entry = _findOrEmplace(_root, reinterpret_cast<const uint8_t*>(&key), inserted, value);
+		if (!inserted)
+		{
+			entry.get() = value;
+		}
+
+		return inserted;
+	}
+
+	template<typename TKey, typename TValue>
+	template<typename... TArgs>
+	constexpr bool CompactLookupMultitable<TKey, TValue>::emplace(const TKey& key, TArgs&&... args)
+	{
+		bool inserted;
+		_findOrEmplace(_root, reinterpret_cast<const uint8_t*>(&key), inserted, std::forward<TArgs>(args)...);
+
+		return inserted;
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr const TValue& CompactLookupMultitable<TKey, TValue>::at(const TKey& key) const
+	{
+		const Value* entry = _find(_root, reinterpret_cast<const uint8_t*>(&key));
+		if (!entry)
+		{
+			throw std::out_of_range("CompactLookupMultitable bad key.");
+		}
+
+		return entry->get();
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr TValue& CompactLookupMultitable<TKey, TValue>::at(const TKey& key)
+	{
+		const CompactLookupMultitable<TKey, TValue>* constThis = this;
+		return const_cast<TValue&>(constThis->at(key));
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr TValue& CompactLookupMultitable<TKey, TValue>::operator[](const TKey& key)
+	{
+		bool inserted;
+		return _findOrEmplace(_root, reinterpret_cast<const uint8_t*>(&key), inserted).get();
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr TValue* CompactLookupMultitable<TKey, TValue>::find(const TKey& key)
+	{
+		const CompactLookupMultitable<TKey, TValue>* constThis = this;
+		return const_cast<TValue*>(constThis->find(key));
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr const TValue* CompactLookupMultitable<TKey, TValue>::find(const TKey& key) const
+	{
+		const Value* entry = _find(_root, reinterpret_cast<const uint8_t*>(&key));
+		return entry ? &entry->get() : nullptr;
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr bool CompactLookupMultitable<TKey, TValue>::contains(const TKey& key) const
+	{
+		return _find(_root, reinterpret_cast<const uint8_t*>(&key));
+	}
+
+	template<typename TKey, typename TValue>
+	template<uint64_t Level>
+	constexpr auto CompactLookupMultitable<TKey, TValue>::_find(const Node<Level>& node, const uint8_t* address) -> const Value*
+	{
+		if (!node.contains(*address))
+		{
+			return nullptr;
+		}
+
+		const auto& child = node.children[node.indexOf(*address)];
+		if constexpr (Level == _keySize)
+		{
+			return &child;
+		}
+		else
+		{
+			return _find<Level + 1>(child, address + 1);
+		}
+	}
+
+	template<typename TKey, typename TValue>
+	template<uint64_t Level, typename... TArgs>
+	constexpr auto CompactLookupMultitable<TKey, TValue>::_findOrEmplace(Node<Level>& node, const uint8_t* address, bool& inserted, TArgs&&... args) -> Value&
+	{
+		const uint16_t index = node.indexOf(*address);
+
+		if (!node.contains(*address))
+		{
+			node.bitmap[*address >> 6] |= 1ULL << (*address & 63);
+			if constexpr (Level == _keySize)
+			{
+				inserted = true;
+				return *node.children.emplace(node.children.begin() + index, std::in_place, std::forward<TArgs>(args)...);
+			}
+			else
+			{
+				node.children.emplace(node.children.begin() + index);
+			}
+		}
+		else if constexpr (Level == _keySize)
+		{
+			inserted = false;
+			return node.children[index];
+		}
+
+		if constexpr (Level != _keySize)
+		{
+			return _findOrEmplace<Level + 1>(node.children[index], address + 1, inserted, std::forward<TArgs>(args)...);
+		}
+	}
+
+	template<typename TKey, typename TValue>
+	template<uint64_t Level>
+	constexpr uint64_t CompactLookupMultitable<TKey, TValue>::_size(const Node<Level>& node)
+	{
+		if constexpr (Level == _keySize)
+		{
+			return node.children.size();
+		}
+		else
+		{
+			uint64_t size = 0;
+			for (const Node<Level + 1>& child : node.children)
+			{
+				size += _size<Level + 1>(child);
+			}
+
+			return size;
+		}
+	}
+
+	template<typename TKey, typename TValue>
+	template<uint64_t Level>
+	constexpr bool CompactLookupMultitable<TKey, TValue>::Node<Level>::contains(uint8_t byte) const
+	{
+		return (bitmap[byte >> 6] >> (byte & 63)) & 1;
+	}
+
+	template<typename TKey, typename TValue>
+	template<uint64_t Level>
+	constexpr uint16_t CompactLookupMultitable<TKey, TValue>::Node<Level>::indexOf(uint8_t byte) const
+	{
+		// Number of present bytes lower than byte
+
+		uint16_t index = 0;
+		for (uint8_t i = 0; i < (byte >> 6); ++i)
+		{
+			index += std::popcount(bitmap[i]);
+		}
+
+		return index + std::popcount(bitmap[byte >> 6] & ((1ULL << (byte & 63)) - 1));
+	}
+
+	template<typename TKey, typename TValue>
+	template<typename... TArgs>
+	constexpr CompactLookupMultitable<TKey, TValue>::InlineValue::InlineValue(std::in_place_t, TArgs&&... args) :
+		value(std::forward<TArgs>(args)...)
+	{
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr TValue& CompactLookupMultitable<TKey, TValue>::InlineValue::get()
+	{
+		return value;
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr const TValue& CompactLookupMultitable<TKey, TValue>::InlineValue::get() const
+	{
+		return value;
+	}
+
+	template<typename TKey, typename TValue>
+	template<typename... TArgs>
+	constexpr CompactLookupMultitable<TKey, TValue>::BoxedValue::BoxedValue(std::in_place_t, TArgs&&... args) :
+		value(new TValue(std::forward<TArgs>(args)...))
+	{
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr CompactLookupMultitable<TKey, TValue>::BoxedValue::BoxedValue(const BoxedValue& boxedValue) :
+		value(new TValue(*boxedValue.value))
+	{
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr auto CompactLookupMultitable<TKey, TValue>::BoxedValue::operator=(const BoxedValue& boxedValue) -> BoxedValue&
+	{
+		value.reset(new TValue(*boxedValue.value));
+		return *this;
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr TValue& CompactLookupMultitable<TKey, TValue>::BoxedValue::get()
+	{
+		return *value;
+	}
+
+	template<typename TKey, typename TValue>
+	constexpr const TValue& CompactLookupMultitable<TKey, TValue>::BoxedValue::get() const
+	{
+		return *value;
+	}
+}
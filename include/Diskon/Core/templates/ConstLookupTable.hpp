@@ -0,0 +1,221 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//! \file
+//! \author Plgrin Marius
+//! \copyright The MIT License (MIT)
+//! \date 2022-2023
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <Diskon/Core/CoreDecl.hpp>
+
+namespace dsk
+{
+	namespace _dsk
+	{
+		constexpr uint64_t constLookupHash(uint64_t key, uint64_t seed)
+		{
+			// Finalizer of MurmurHash3, after mixing the seed in
+
+			key ^= seed * 0x9E3779B97F4A7C15;
+			key ^= key >> 33;
+			key *= 0xFF51AFD7ED558CCD;
+			key ^= key >> 33;
+			key *= 0xC4CEB9FE1A85EC53;
+			key ^= key >> 33;
+
+			return key;
+		}
+
+		constexpr uint64_t constLookupHash(std::string_view key, uint64_t seed)
+		{
+			// FNV-1a
+
+			uint64_t hash = 0xCBF29CE484222325;
+			for (const char c : key)
+			{
+				hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001B3;
+			}
+
+			return constLookupHash(hash, seed);
+		}
+
+		template<typename TKey> requires std::is_integral_v<TKey> || std::is_enum_v<TKey>
+		constexpr uint64_t constLookupHash(TKey key, uint64_t seed)
+		{
+			return constLookupHash(static_cast<uint64_t>(key), seed);
+		}
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr ConstLookupTable<TKey, TValue, Size>::ConstLookupTable(const Entry (&entries)[Size]) :
+		_slots(),
+		_seeds(),
+		_isDense(false),
+		_minKey(0)
+	{
+		// Dense array if the keys are integers in a range not larger than the table
+
+		if constexpr (std::is_integral_v<TKey> || std::is_enum_v<TKey>)
+		{
+			uint64_t minKey = static_cast<uint64_t>(entries[0].first);
+			uint64_t maxKey = minKey;
+			for (const Entry& entry : entries)
+			{
+				minKey = std::min<uint64_t>(minKey, static_cast<uint64_t>(entry.first));
+				maxKey = std::max<uint64_t>(maxKey, static_cast<uint64_t>(entry.first));
+			}
+
+			if (maxKey - minKey < _tableSize)
+			{
+				_isDense = true;
+				_minKey = minKey;
+
+				for (const Entry& entry : entries)
+				{
+					Slot& slot = _slots[static_cast<uint64_t>(entry.first) - _minKey];
+					if (slot.used)
+					{
+						throw std::invalid_argument("ConstLookupTable duplicate key.");
+					}
+
+					slot = { entry.first, entry.second, true };
+				}
+
+				return;
+			}
+		}
+
+		// Perfect hash: place the largest buckets first, while the table is still empty
+
+		std::array<uint64_t, Size> entryBuckets;
+		std::array<uint64_t, _bucketCount> bucketSizes = {};
+		for (uint64_t i = 0; i < Size; ++i)
+		{
+			entryBuckets[i] = _dsk::constLookupHash(entries[i].first, 0) % _bucketCount;
+			++bucketSizes[entryBuckets[i]];
+		}
+
+		std::array<uint64_t, _bucketCount> bucketOrder;
+		for (uint64_t i = 0; i < _bucketCount; ++i)
+		{
+			bucketOrder[i] = i;
+		}
+		std::sort(bucketOrder.begin(), bucketOrder.end(), [&](uint64_t a, uint64_t b) { return bucketSizes[a] > bucketSizes[b]; });
+
+		for (const uint64_t bucket : bucketOrder)
+		{
+			if (bucketSizes[bucket] == 0)
+			{
+				break;
+			}
+
+			std::array<uint64_t, Size> bucketEntries;
+			uint64_t bucketSize = 0;
+			for (uint64_t i = 0; i < Size; ++i)
+			{
+				if (entryBuckets[i] == bucket)
+				{
+					bucketEntries[bucketSize++] = i;
+				}
+			}
+
+			// Try seeds until all the keys of the bucket fall in distinct free slots
+
+			uint32_t seed = 1;
+			std::array<uint64_t, Size> slotIndices;
+			for (; seed < _maxSeed; ++seed)
+			{
+				bool success = true;
+				for (uint64_t i = 0; i < bucketSize && success; ++i)
+				{
+					slotIndices[i] = _dsk::constLookupHash(entries[bucketEntries[i]].first, seed) & _tableFilter;
+					success = !_slots[slotIndices[i]].used;
+					for (uint64_t j = 0; j < i && success; ++j)
+					{
+						if (slotIndices[j] == slotIndices[i])
+						{
+							if (entries[bucketEntries[j]].first == entries[bucketEntries[i]].first)
+							{
+								throw std::invalid_argument("ConstLookupTable duplicate key.");
+							}
+
+							success = false;
+						}
+					}
+				}
+
+				if (success)
+				{
+					break;
+				}
+			}
+
+			if (seed == _maxSeed)
+			{
+				throw std::invalid_argument("ConstLookupTable could not find a perfect hash.");
+			}
+
+			_seeds[bucket] = seed;
+			for (uint64_t i = 0; i < bucketSize; ++i)
+			{
+				_slots[slotIndices[i]] = { entries[bucketEntries[i]].first, entries[bucketEntries[i]].second, true };
+			}
+		}
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr uint64_t ConstLookupTable<TKey, TValue, Size>::size() const
+	{
+		return Size;
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr const TValue& ConstLookupTable<TKey, TValue, Size>::at(const TKey& key) const
+	{
+		const TValue* value = find(key);
+		if (!value)
+		{
+			throw std::out_of_range("ConstLookupTable bad key.");
+		}
+
+		return *value;
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr const TValue* ConstLookupTable<TKey, TValue, Size>::find(const TKey& key) const
+	{
+		const uint64_t index = _slotIndex(key);
+		if (index >= _tableSize || !_slots[index].used || !(_slots[index].key == key))
+		{
+			return nullptr;
+		}
+
+		return &_slots[index].value;
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr bool ConstLookupTable<TKey, TValue, Size>::contains(const TKey& key) const
+	{
+		return find(key);
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr uint64_t ConstLookupTable<TKey, TValue, Size>::_slotIndex(const TKey& key) const
+	{
+		if constexpr (std::is_integral_v<TKey> || std::is_enum_v<TKey>)
+		{
+			if (_isDense)
+			{
+				return static_cast<uint64_t>(key) - _minKey;
+			}
+		}
+
+		const uint32_t seed = _seeds[_dsk::constLookupHash(key, 0) % _bucketCount];
+		return _dsk::constLookupHash(key, seed) & _tableFilter;
+	}
+
+	template<typename TKey, typename TValue, uint64_t Size>
+	constexpr ConstLookupTable<TKey, TValue, Size> makeConstLookupTable(const std::pair<TKey, TValue> (&entries)[Size])
+	{
+		return ConstLookupTable<TKey, TValue, Size>(entries);
+	}
+}
@@ -53,6 +53,44 @@ namespace dsk
 			return ~crc;
 		}
 
+		template<typename TValue, TValue RevPoly>
+		constexpr TValue Crc<TValue, RevPoly>::combine(TValue crc, TValue nextCrc, uint64_t nextSize) const
+		{
+			// The CRC of the first part is shifted by multiplying it by x^(8 * nextSize), computed by squaring
+
+			constexpr TValue one = TValue(1) << (sizeof(TValue) * 8 - 1);
+
+			TValue shift = one;
+			for (TValue power = one >> 8; nextSize; nextSize >>= 1, power = _multiply(power, power))
+			{
+				if (nextSize & 1)
+				{
+					shift = _multiply(power, shift);
+				}
+			}
+
+			return _multiply(shift, crc) ^ nextCrc;
+		}
+
+		template<typename TValue, TValue RevPoly>
+		constexpr TValue Crc<TValue, RevPoly>::_multiply(TValue a, TValue b)
+		{
+			TValue product = 0;
+			for (TValue mask = TValue(1) << (sizeof(TValue) * 8 - 1); ; mask >>= 1)
+			{
+				if (a & mask)
+				{
+					product ^= b;
+					if ((a & (mask - 1)) == 0)
+					{
+						return product;
+					}
+				}
+
+				b = (b & 1) ? (b >> 1) ^ RevPoly : (b >> 1);
+			}
+		}
+
 
 		template<typename TValue, typename THalf, TValue Modulus>
 		constexpr TValue Fletcher<TValue, THalf, Modulus>::operator()(const void* src, uint64_t size, TValue initialValue) const
@@ -61,18 +99,79 @@ namespace dsk
 			static constexpr TValue lowFilter = std::numeric_limits<TValue>::max() >> halfShift;
 			static constexpr uint64_t sizeFilter = ~(sizeof(THalf) - 1);
 
-			TValue a = initialValue & lowFilter;
-			TValue b = initialValue >> halfShift;
+			static constexpr uint64_t runSize = _computeRunSize();
+
+			uint64_t a = initialValue & lowFilter;
+			uint64_t b = initialValue >> halfShift;
 
 			const THalf* it = reinterpret_cast<const THalf*>(src);
-			const THalf* const itEnd = it + (size & sizeFilter);
-			for (; it != itEnd; ++it)
+			const THalf* const itEnd = it + (size & sizeFilter) / sizeof(THalf);
+			while (it != itEnd)
+			{
+				const THalf* const runEnd = it + std::min<uint64_t>(itEnd - it, runSize);
+				for (; it != runEnd; ++it)
+				{
+					a += *it;
+					b += a;
+				}
+
+				a %= Modulus;
+				b %= Modulus;
+			}
+
+			return static_cast<TValue>((b << halfShift) | a);
+		}
+
+		template<typename TValue, typename THalf, TValue Modulus>
+		constexpr TValue Fletcher<TValue, THalf, Modulus>::combine(TValue value, TValue nextValue, uint64_t nextSize, TValue initialValue) const
+		{
+			static constexpr uint8_t halfShift = sizeof(TValue) * 4;
+			static constexpr TValue lowFilter = std::numeric_limits<TValue>::max() >> halfShift;
+
+			// Each sum of the second part started from the initial sums instead of the ones of the first part, and the
+			// difference of the first sums was added to the second sums once per word
+
+			const uint64_t a0 = initialValue & lowFilter;
+			const uint64_t b0 = initialValue >> halfShift;
+			const uint64_t a1 = value & lowFilter;
+			const uint64_t b1 = value >> halfShift;
+			const uint64_t a2 = nextValue & lowFilter;
+			const uint64_t b2 = nextValue >> halfShift;
+			const uint64_t wordCount = (nextSize / sizeof(THalf)) % Modulus;
+
+			const uint64_t a = (a1 + a2 + Modulus - a0) % Modulus;
+			const uint64_t b = ((b1 + b2 + Modulus - b0) % Modulus + wordCount * ((a1 + Modulus - a0) % Modulus)) % Modulus;
+
+			return static_cast<TValue>((b << halfShift) | a);
+		}
+
+		template<typename TValue, typename THalf, TValue Modulus>
+		constexpr uint64_t Fletcher<TValue, THalf, Modulus>::_computeRunSize()
+		{
+			// After n words, a is at most a0 + n * maxWord and b at most b0 + n * a0 + maxWord * n * (n + 1) / 2, with a0 and
+			// b0 the sums at the beginning of the run (as zlib's NMAX, for 64-bit sums)
+
+			constexpr uint64_t maxSum = std::numeric_limits<TValue>::max() >> (sizeof(TValue) * 4);
+			constexpr uint64_t maxWord = std::numeric_limits<THalf>::max();
+			constexpr uint64_t maxRunSize = 1 << 20;
+
+			uint64_t low = 1;
+			uint64_t high = maxRunSize;
+			while (low < high)
 			{
-				a = (a + *it) % Modulus;
-				b = (a + b) % Modulus;
+				const uint64_t n = (low + high + 1) / 2;
+				const uint64_t fixedPart = maxSum + n * maxSum;
+				if (fixedPart <= std::numeric_limits<uint64_t>::max() / 2 && n * (n + 1) / 2 <= (std::numeric_limits<uint64_t>::max() - fixedPart) / maxWord)
+				{
+					low = n;
+				}
+				else
+				{
+					high = n - 1;
+				}
 			}
 
-			return (b << halfShift) | a;
+			return low;
 		}
 	}
 
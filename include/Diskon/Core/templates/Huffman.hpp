@@ -9,177 +9,221 @@
 
 namespace dsk
 {
-	template<typename TSymbol>
-	HuffmanTableEntry<TSymbol>* HuffmanTableEntry<TSymbol>::createTable()
-	{
-		return new HuffmanTableEntry<TSymbol>[256];
-	}
-
-	template<typename TSymbol>
-	bool HuffmanTableEntry<TSymbol>::addSymbol(HuffmanTableEntry<TSymbol>* table, const TSymbol& symbol, uint64_t codeLength, uint8_t* code)
+	namespace _dsk
 	{
-		assert(table);
-		assert(codeLength != 0);
-
-		if (codeLength <= 8)
+		constexpr bool huffmanCodeLengthsToCodes(const uint64_t* codeLengths, uint64_t* codes, uint64_t symbolCount)
 		{
-			const uint8_t filter = (0xFF >> codeLength);
-			for (uint16_t i = 0; i < 256; ++table, ++i)
+			// Count the number of codes of each length
+
+			uint64_t lengthCounts[65] = {};
+			for (uint64_t i = 0; i < symbolCount; ++i)
 			{
-				if (table->bitCount == 0 && !table->next && (i & filter) == 0)
-				{
-					const uint8_t span = (1 << (8 - codeLength));
+				assert(codeLengths[i] <= 64);
+				++lengthCounts[codeLengths[i]];
+			}
+			lengthCounts[0] = 0;
 
-					if (i + span > 256)
-					{
-						return false;
-					}
+			// Check the code lengths are not over-subscribed. Once there are more free codes than symbols, it cannot happen anymore.
 
-					const HuffmanTableEntry<TSymbol>* const tableEnd = table + span;
+			uint64_t freeCodes = 1;
+			for (uint8_t i = 1; i <= 64 && freeCodes <= symbolCount; ++i)
+			{
+				freeCodes <<= 1;
+				if (lengthCounts[i] > freeCodes)
+				{
+					return false;
+				}
+				freeCodes -= lengthCounts[i];
+			}
 
-					for (; table != tableEnd; ++table)
-					{
-						table->bitCount = codeLength;
-						table->symbol = symbol;
-					}
+			// Compute the first code of each length
 
-					if (code)
-					{
-						*code = i;
-					}
+			uint64_t nextCodes[65] = {};
+			for (uint8_t i = 1; i < 64; ++i)
+			{
+				nextCodes[i + 1] = (nextCodes[i] + lengthCounts[i]) << 1;
+			}
 
-					return true;
-				}
+			// Assign codes in symbol order
 
-				assert(table->bitCount == 0 || table->symbol != symbol);
-			}
-		}
-		else
-		{
-			for (uint16_t i = 0; i < 256; ++table, ++i)
+			for (uint64_t i = 0; i < symbolCount; ++i)
 			{
-				if (table->bitCount == 0)
+				if (codeLengths[i])
 				{
-					if (code)
-					{
-						*code = i;
-					}
-
-					if (table->next)
-					{
-						if (addSymbol(table->next, symbol, codeLength - 8, code + (code != nullptr)))
-						{
-							return true;
-						}
-						else
-						{
-							continue;
-						}
-					}
-					else
-					{
-						table->next = createTable();
-						return addSymbol(table->next, symbol, codeLength - 8, code + (code != nullptr));
-					}
+					codes[i] = nextCodes[codeLengths[i]]++;
 				}
 				else
 				{
-					assert(table->symbol != symbol);
+					codes[i] = 0;
 				}
 			}
-		}
 
-		return false;
-	}
+			return true;
+		}
 
-	template<typename TSymbol>
-	void HuffmanTableEntry<TSymbol>::swapEndianness(HuffmanTableEntry<TSymbol>* table)
-	{
-		// 0 and 255 can be skipped because they're invariant by bitswap
-		for (uint8_t i = 1; i < 255; ++i)
+		constexpr uint64_t huffmanReverseCode(uint64_t code, uint8_t codeLength)
 		{
-			uint8_t j = bitswap(i);
-			if (j > i)
+			uint64_t reversed = 0;
+			for (uint8_t i = 0; i < codeLength; ++i, code >>= 1)
 			{
-				std::swap(table[i], table[j]);
+				reversed = (reversed << 1) | (code & 1);
 			}
+
+			return reversed;
 		}
 
-		const HuffmanTableEntry<TSymbol>* const tableEnd = table + 256;
-		for (; table != tableEnd; ++table)
+		constexpr uint64_t huffmanStreamSymbolCount(uint64_t symbolCount, uint8_t streamIndex)
 		{
-			if (table->bitCount == 0 && table->next)
-			{
-				swapEndianness(table->next);
-			}
+			const uint64_t segmentSize = (symbolCount + huffmanStreamCount - 1) / huffmanStreamCount;
+			const uint64_t segmentBegin = std::min(segmentSize * streamIndex, symbolCount);
+
+			return std::min(segmentSize, symbolCount - segmentBegin);
 		}
-	}
 
-	template<typename TSymbol>
-	void HuffmanTableEntry<TSymbol>::destroyTable(HuffmanTableEntry<TSymbol>* table)
-	{
-		const HuffmanTableEntry<TSymbol>* const tableEnd = table + 256;
-		for (; table != tableEnd; ++table)
+		constexpr void huffmanOccurencesToCodeLengths(const uint64_t* occurences, uint64_t* codeLengths, uint64_t symbolCount, uint8_t maxCodeLength, uint64_t* scratch)
 		{
-			if (table->bitCount == 0 && table->next)
+			// Gather the used symbols and sort them by ascending occurences
+
+			uint64_t* const indices = scratch;
+			uint64_t* const weights = scratch + symbolCount;
+
+			uint64_t usedCount = 0;
+			for (uint64_t i = 0; i < symbolCount; ++i)
 			{
-				destroyTable(table->next);
+				codeLengths[i] = 0;
+				if (occurences[i])
+				{
+					indices[usedCount++] = i;
+				}
 			}
-		}
 
-		delete[](table - 256);
-	}
+			if (usedCount == 0)
+			{
+				return;
+			}
+			else if (usedCount == 1)
+			{
+				codeLengths[indices[0]] = 1;
+				return;
+			}
 
+			assert(maxCodeLength <= 64 && (maxCodeLength == 64 || (1ULL << maxCodeLength) >= usedCount));
 
-	namespace _dsk
-	{
-		template<typename TSymbol>
-		struct Node
-		{
-			bool isLeaf;
-			uint64_t occurences;
+			std::sort(indices, indices + usedCount, [&](uint64_t a, uint64_t b) { return occurences[a] < occurences[b] || (occurences[a] == occurences[b] && a < b); });
 
-			union
+			for (uint64_t i = 0; i < usedCount; ++i)
 			{
-				uint64_t index;
+				weights[i] = occurences[indices[i]];
+			}
+
+			/*
+			* In-place computation of the code lengths (Moffat & Katajainen, "In-Place Calculation of Minimum-Redundancy Codes").
+			* First pass merges the nodes and stores the parent of each internal node, second pass turns the parents into
+			* depths, and third pass computes the depth of the leaves, from the deepest (lowest occurences) to the shallowest.
+			*/
 
-				struct
+			const int64_t n = usedCount;
+			int64_t root = 0;
+			int64_t leaf = 2;
+
+			weights[0] += weights[1];
+			for (int64_t next = 1; next < n - 1; ++next)
+			{
+				if (leaf >= n || weights[root] < weights[leaf])
 				{
-					Node* childA;
-					Node* childB;
-				};
-			};
+					weights[next] = weights[root];
+					weights[root++] = next;
+				}
+				else
+				{
+					weights[next] = weights[leaf++];
+				}
+
+				if (leaf >= n || (root < next && weights[root] < weights[leaf]))
+				{
+					weights[next] += weights[root];
+					weights[root++] = next;
+				}
+				else
+				{
+					weights[next] += weights[leaf++];
+				}
+			}
+
+			weights[n - 2] = 0;
+			for (int64_t next = n - 3; next >= 0; --next)
+			{
+				weights[next] = weights[weights[next]] + 1;
+			}
 
-			void destroy()
+			int64_t available = 1;
+			int64_t used = 0;
+			uint64_t depth = 0;
+			root = n - 2;
+			int64_t next = n - 1;
+			while (available > 0)
 			{
-				if (!isLeaf)
+				while (root >= 0 && weights[root] == depth)
 				{
-					childA->destroy();
-					childB->destroy();
+					++used;
+					--root;
+				}
 
-					delete childA;
-					delete childB;
+				while (available > used)
+				{
+					weights[next--] = depth;
+					--available;
 				}
+
+				available = 2 * used;
+				++depth;
+				used = 0;
 			}
 
-			static bool compare(const Node<TSymbol>* a, const Node<TSymbol>* b)
+			// Count the code lengths, clamping the ones that are too long
+
+			uint64_t lengthCounts[65] = {};
+			for (uint64_t i = 0; i < usedCount; ++i)
 			{
-				return a->occurences > b->occurences;
+				++lengthCounts[std::min<uint64_t>(weights[i], maxCodeLength)];
 			}
-		};
 
-		template<typename TSymbol>
-		void extractCodeLengths(const Node<TSymbol>* node, uint64_t* codeLengths, uint64_t currentLength)
-		{
-			if (node->isLeaf)
+			// If some code lengths were clamped, the code is over-subscribed. Repair it by moving leaves down the tree until it is complete.
+
+			if (weights[0] > maxCodeLength)
 			{
-				codeLengths[node->index] = currentLength;
+				uint64_t total = 0;
+				for (uint8_t i = 1; i <= maxCodeLength; ++i)
+				{
+					total += lengthCounts[i] << (maxCodeLength - i);
+				}
+
+				const uint64_t fullTotal = maxCodeLength == 64 ? 0 : 1ULL << maxCodeLength;
+				while (total != fullTotal)
+				{
+					--lengthCounts[maxCodeLength];
+					for (uint8_t i = maxCodeLength - 1; i > 0; --i)
+					{
+						if (lengthCounts[i])
+						{
+							--lengthCounts[i];
+							lengthCounts[i + 1] += 2;
+							break;
+						}
+					}
+					--total;
+				}
 			}
-			else
+
+			// Assign the longest codes to the least frequent symbols
+
+			uint64_t i = 0;
+			for (uint8_t length = maxCodeLength; length > 0; --length)
 			{
-				++currentLength;
-				extractCodeLengths(node->childA, codeLengths, currentLength);
-				extractCodeLengths(node->childB, codeLengths, currentLength);
+				for (uint64_t j = 0; j < lengthCounts[length]; ++j, ++i)
+				{
+					codeLengths[indices[i]] = length;
+				}
 			}
 		}
 	}
@@ -188,52 +232,14 @@ namespace dsk
 	template<typename TSymbol, std::endian BitEndianness>
 	void HuffmanEncoder<TSymbol, BitEndianness>::symbolOccurencesToCodeLengths(const TSymbol* symbols, const uint64_t* symbolOccurences, uint64_t* codeLengths, uint64_t symbolCount)
 	{
-		if (symbolCount == 0)
-		{
-			return;
-		}
-		else if (symbolCount == 1)
-		{
-			*codeLengths = 1;
-			return;
-		}
-
-		std::vector<_dsk::Node<TSymbol>*> nodes(symbolCount);
-		for (uint64_t i = 0; i < symbolCount; ++i)
-		{
-			nodes[i] = new _dsk::Node<TSymbol>;
-			nodes[i]->isLeaf = true;
-			nodes[i]->occurences = symbolOccurences[i];
-			nodes[i]->index = i;
-		}
-
-		_dsk::Node<TSymbol>** nodesBegin = nodes.data();
-		_dsk::Node<TSymbol>** nodesEnd = nodesBegin + symbolCount;
-
-		std::make_heap(nodesBegin, nodesEnd, _dsk::Node<TSymbol>::compare);
-
-		for (uint64_t i = 0; i < symbolCount - 1; ++i)
-		{
-			std::pop_heap(nodesBegin, nodesEnd, _dsk::Node<TSymbol>::compare);
-			--nodesEnd;
-			std::pop_heap(nodesBegin, nodesEnd, _dsk::Node<TSymbol>::compare);
-			--nodesEnd;
-
-			_dsk::Node<TSymbol>* node = new _dsk::Node<TSymbol>;
-			node->isLeaf = false;
-			node->childA = *nodesEnd;
-			node->childB = *(nodesEnd + 1);
-			node->occurences = node->childA->occurences + node->childB->occurences;
-
-			*nodesEnd = node;
-
-			++nodesEnd;
-			std::push_heap(nodesBegin, nodesEnd, _dsk::Node<TSymbol>::compare);
-		}
-
-		_dsk::extractCodeLengths(*nodesBegin, codeLengths, 0);
+		std::vector<uint64_t> scratch(2 * symbolCount);
+		_dsk::huffmanOccurencesToCodeLengths(symbolOccurences, codeLengths, symbolCount, 64, scratch.data());
+	}
 
-		(*nodesBegin)->destroy();
+	template<typename TSymbol, std::endian BitEndianness>
+	void HuffmanEncoder<TSymbol, BitEndianness>::symbolOccurencesToCodeLengths(const uint64_t* symbolOccurences, uint64_t* codeLengths, uint64_t symbolCount, uint8_t maxCodeLength, uint64_t* scratch)
+	{
+		_dsk::huffmanOccurencesToCodeLengths(symbolOccurences, codeLengths, symbolCount, maxCodeLength, scratch);
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
@@ -244,14 +250,13 @@ namespace dsk
 		symbols.clear();
 		symbolOccurences.clear();
 
-		LookupMultitable<TSymbol, uint64_t> symbolToIndex;
-		const auto symbolToIndexEnd = symbolToIndex.end();
+		CompactLookupMultitable<TSymbol, uint64_t> symbolToIndex;
 
 		const TSymbol* const symbolBufferEnd = symbolBuffer + bufferLength;
 		for (; symbolBuffer != symbolBufferEnd; ++symbolBuffer)
 		{
-			const auto it = symbolToIndex.find(*symbolBuffer);
-			if (it == symbolToIndexEnd)
+			const uint64_t* index = symbolToIndex.find(*symbolBuffer);
+			if (!index)
 			{
 				symbolToIndex.emplace(*symbolBuffer, symbols.size());
 				symbols.push_back(*symbolBuffer);
@@ -259,65 +264,104 @@ namespace dsk
 			}
 			else
 			{
-				++symbolOccurences[*(it->second)];
+				++symbolOccurences[*index];
 			}
 		}
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
 	HuffmanEncoder<TSymbol, BitEndianness>::HuffmanEncoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount) :
-		_table()
+		_table(),
+		_denseTable(),
+		_maxCodeLength(0)
 	{
-		HuffmanTableEntry<TSymbol>* table = HuffmanTableEntry<TSymbol>::createTable();
+		std::vector<uint64_t> codes(symbolCount);
+		bool success = _dsk::huffmanCodeLengthsToCodes(codeLengths, codes.data(), symbolCount);
+		assert(success);
 
-		const TSymbol* const symbolsEnd = symbols + symbolCount;
-		for (; symbols != symbolsEnd; ++symbols, ++codeLengths)
+		for (uint64_t i = 0; i < symbolCount; ++i)
 		{
+			if (codeLengths[i] == 0)
+			{
+				continue;
+			}
+
+			_maxCodeLength = std::max<uint8_t>(_maxCodeLength, codeLengths[i]);
+
+			// Write the code MSB first, starting from the first byte
+
 			Code code;
-			code.byteCount = (*codeLengths >> 3);
-			code.bitCount = *codeLengths & 7;
-			code.data = new uint8_t[code.byteCount + (code.bitCount != 0)];
+			code.byteCount = (codeLengths[i] >> 3);
+			code.bitCount = codeLengths[i] & 7;
 
-			bool success = HuffmanTableEntry<TSymbol>::addSymbol(table, *symbols, *codeLengths, code.data);
-			assert(success);
+			const uint64_t alignedCode = codes[i] << (64 - codeLengths[i]);
+			for (uint8_t j = 0; j < 8; ++j)
+			{
+				code.data[j] = alignedCode >> (56 - (j << 3));
+				if constexpr (BitEndianness == std::endian::little)
+				{
+					code.data[j] = bitswap(code.data[j]);
+				}
+			}
 
-			success = _table.emplace(*symbols, code);
+			success = _table.emplace(symbols[i], code);
 			assert(success);
 		}
 
-		if constexpr (BitEndianness == std::endian::little)
+		// Build the dense table if the alphabet allows it, with the codes already in the order they are written
+
+		if constexpr (_hasDenseTable)
 		{
-			for (const std::pair<TSymbol, Code*>& elt : _table)
+			using UnsignedSymbol = std::make_unsigned_t<TSymbol>;
+
+			uint64_t denseSize = 0;
+			for (uint64_t i = 0; i < symbolCount; ++i)
 			{
-				uint8_t* data = elt.second->data;
-				const uint8_t* const dataEnd = data + elt.second->byteCount + (elt.second->bitCount != 0);
-				for (; data != dataEnd; ++data)
+				if (codeLengths[i] > _maxDenseCodeLength)
+				{
+					return;
+				}
+				else if (codeLengths[i])
 				{
-					*data = bitswap(*data);
+					denseSize = std::max<uint64_t>(denseSize, static_cast<UnsignedSymbol>(symbols[i]) + 1);
 				}
 			}
-		}
 
-		HuffmanTableEntry<TSymbol>::destroyTable(table);
+			_denseTable.resize(denseSize, { 0, 0 });
+			for (uint64_t i = 0; i < symbolCount; ++i)
+			{
+				if (codeLengths[i])
+				{
+					DenseCode& denseCode = _denseTable[static_cast<UnsignedSymbol>(symbols[i])];
+					denseCode.length = codeLengths[i];
+					if constexpr (BitEndianness == std::endian::little)
+					{
+						denseCode.bits = _dsk::huffmanReverseCode(codes[i], codeLengths[i]);
+					}
+					else
+					{
+						denseCode.bits = codes[i];
+					}
+				}
+			}
+		}
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
 	template<uint8_t DstOffset>
 	void HuffmanEncoder<TSymbol, BitEndianness>::writeSymbol(const TSymbol& symbol, uint8_t* dst, uint64_t& bytesWritten, uint8_t& bitsWritten) const
 	{
-		auto it = _table.find(symbol);
-		assert(it != _table.end());
+		const Code* code = _table.find(symbol);
+		assert(code);
 
-		const Code& code = *(it->second);
+		bytesWritten = code->byteCount;
+		bitsWritten = code->bitCount;
 
-		bytesWritten = code.byteCount;
-		bitsWritten = code.bitCount;
-
-		bitcpy<BitEndianness, 0, DstOffset>(code.data, dst, bytesWritten, bitsWritten);
+		bitcpy<BitEndianness, 0, DstOffset>(code->data, dst, bytesWritten, bitsWritten);
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
-	void HuffmanEncoder<TSymbol, BitEndianness>::writeSymbol(const TSymbol& symbol, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten)
+	void HuffmanEncoder<TSymbol, BitEndianness>::writeSymbol(const TSymbol& symbol, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten) const
 	{
 		assert(dstOffset < 8);
 
@@ -343,86 +387,317 @@ namespace dsk
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
-	HuffmanEncoder<TSymbol, BitEndianness>::~HuffmanEncoder()
+	void HuffmanEncoder<TSymbol, BitEndianness>::encodeSymbols(const TSymbol* symbols, uint64_t symbolCount, uint8_t* dst, uint8_t dstOffset, uint64_t& bytesWritten, uint8_t& bitsWritten) const
 	{
-		for (const std::pair<TSymbol, Code*> elt : _table)
+		assert(dstOffset < 8);
+
+		const TSymbol* const symbolsEnd = symbols + symbolCount;
+
+		if (_denseTable.empty())
 		{
-			delete[] elt.second->data;
+			uint64_t byteCount = 0;
+			uint8_t bitCount = dstOffset;
+			for (; symbols != symbolsEnd; ++symbols)
+			{
+				uint64_t symbolBytesWritten;
+				uint8_t symbolBitsWritten;
+				writeSymbol(*symbols, dst + byteCount, bitCount, symbolBytesWritten, symbolBitsWritten);
+				bitCount += symbolBitsWritten;
+				byteCount += symbolBytesWritten + (bitCount >> 3);
+				bitCount &= 7;
+			}
+
+			const uint64_t bitsTotal = (byteCount << 3) + bitCount - dstOffset;
+			bytesWritten = bitsTotal >> 3;
+			bitsWritten = bitsTotal & 7;
+		}
+		else if constexpr (_hasDenseTable)
+		{
+			using UnsignedSymbol = std::make_unsigned_t<TSymbol>;
+
+			// The accumulator is flushed 32 bits at a time and codes are at most 32 bits long, so it never overflows
+
+			uint64_t byteCount = 0;
+			uint64_t accumulator;
+			uint8_t accumulatorBits = dstOffset;
+			if constexpr (BitEndianness == std::endian::little)
+			{
+				accumulator = *dst & ((1 << dstOffset) - 1);
+			}
+			else
+			{
+				accumulator = static_cast<uint64_t>(*dst & ~(0xFF >> dstOffset)) << 56;
+			}
+
+			for (; symbols != symbolsEnd; ++symbols)
+			{
+				assert(static_cast<UnsignedSymbol>(*symbols) < _denseTable.size());
+				const DenseCode& code = _denseTable[static_cast<UnsignedSymbol>(*symbols)];
+				assert(code.length != 0);
+
+				if constexpr (BitEndianness == std::endian::little)
+				{
+					accumulator |= code.bits << accumulatorBits;
+				}
+				else
+				{
+					accumulator |= code.bits << (64 - accumulatorBits - code.length);
+				}
+				accumulatorBits += code.length;
+
+				if (accumulatorBits >= 32)
+				{
+					if constexpr (BitEndianness == std::endian::little)
+					{
+						dst[byteCount] = accumulator;
+						dst[byteCount + 1] = accumulator >> 8;
+						dst[byteCount + 2] = accumulator >> 16;
+						dst[byteCount + 3] = accumulator >> 24;
+						accumulator >>= 32;
+					}
+					else
+					{
+						dst[byteCount] = accumulator >> 56;
+						dst[byteCount + 1] = accumulator >> 48;
+						dst[byteCount + 2] = accumulator >> 40;
+						dst[byteCount + 3] = accumulator >> 32;
+						accumulator <<= 32;
+					}
+					byteCount += 4;
+					accumulatorBits -= 32;
+				}
+			}
+
+			// Flush the remaining bits, the last byte being padded with zeros
+
+			const uint64_t bitsTotal = (byteCount << 3) + accumulatorBits - dstOffset;
+			for (; accumulatorBits > 0; accumulatorBits -= std::min<uint8_t>(accumulatorBits, 8), ++byteCount)
+			{
+				if constexpr (BitEndianness == std::endian::little)
+				{
+					dst[byteCount] = accumulator;
+					accumulator >>= 8;
+				}
+				else
+				{
+					dst[byteCount] = accumulator >> 56;
+					accumulator <<= 8;
+				}
+			}
+
+			bytesWritten = bitsTotal >> 3;
+			bitsWritten = bitsTotal & 7;
 		}
 	}
 
 
 	template<typename TSymbol, std::endian BitEndianness>
-	HuffmanDecoder<TSymbol, BitEndianness>::HuffmanDecoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount) :
-		_table(HuffmanTableEntry<TSymbol>::createTable())
+	uint64_t HuffmanEncoder<TSymbol, BitEndianness>::encodeStreams(const TSymbol* symbols, uint64_t symbolCount, uint8_t* dst) const
 	{
-		const TSymbol* const symbolsEnd = symbols + symbolCount;
-		for (; symbols != symbolsEnd; ++symbols, ++codeLengths)
-		{
-			bool success = HuffmanTableEntry<TSymbol>::addSymbol(_table, *symbols, *codeLengths);
-			assert(success);
-		}
+		constexpr uint8_t streamCount = _dsk::huffmanStreamCount;
 
-		if constexpr (BitEndianness == std::endian::little)
+		uint64_t offset = _dsk::huffmanJumpTableSize;
+		for (uint8_t i = 0; i < streamCount; ++i)
 		{
-			HuffmanTableEntry<TSymbol>::swapEndianness(_table);
+			const uint64_t streamSymbolCount = _dsk::huffmanStreamSymbolCount(symbolCount, i);
+
+			uint64_t bytesWritten;
+			uint8_t bitsWritten;
+			encodeSymbols(symbols, streamSymbolCount, dst + offset, 0, bytesWritten, bitsWritten);
+
+			const uint64_t streamSize = bytesWritten + (bitsWritten != 0);
+			assert(streamSize <= UINT32_MAX);
+			if (i < streamCount - 1)
+			{
+				dst[4 * i] = streamSize;
+				dst[4 * i + 1] = streamSize >> 8;
+				dst[4 * i + 2] = streamSize >> 16;
+				dst[4 * i + 3] = streamSize >> 24;
+			}
+
+			symbols += streamSymbolCount;
+			offset += streamSize;
 		}
+
+		return offset;
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
-	template<uint8_t SrcOffset>
-	bool HuffmanDecoder<TSymbol, BitEndianness>::readSymbol(TSymbol& symbol, const uint8_t* src, uint64_t& bytesRead, uint8_t& bitsRead) const
+	uint64_t HuffmanEncoder<TSymbol, BitEndianness>::getMaxStreamsSize(uint64_t symbolCount) const
+	{
+		// Each stream may end with a partial byte, and encodeSymbols may write a few bytes more than its output
+
+		return _dsk::huffmanJumpTableSize + ((symbolCount * _maxCodeLength + 7) >> 3) + _dsk::huffmanStreamCount + 8;
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	bool HuffmanEncoder<TSymbol, BitEndianness>::getCode(const TSymbol& symbol, uint64_t& bits, uint8_t& bitCount) const
 	{
-		static constexpr uint8_t revSrcOffset = 8 - SrcOffset;
+		if constexpr (_hasDenseTable)
+		{
+			using UnsignedSymbol = std::make_unsigned_t<TSymbol>;
+
+			if (!_denseTable.empty())
+			{
+				if (static_cast<UnsignedSymbol>(symbol) >= _denseTable.size())
+				{
+					return false;
+				}
 
-		const HuffmanTableEntry<TSymbol>* entry;
-		if constexpr (SrcOffset == 0)
+				const DenseCode& code = _denseTable[static_cast<UnsignedSymbol>(symbol)];
+				bits = code.bits;
+				bitCount = code.length;
+				return code.length != 0;
+			}
+		}
+
+		const Code* code = _table.find(symbol);
+		if (!code)
 		{
-			entry = _table + *src;
+			return false;
 		}
-		else
+
+		// Code::data holds the code starting from its first bit, in the bit order of the stream
+
+		bitCount = (code->byteCount << 3) + code->bitCount;
+		bits = 0;
+		for (uint8_t i = 0; i < 8; ++i)
 		{
-			if constexpr (BitEndianness == std::endian::big)
+			if constexpr (BitEndianness == std::endian::little)
 			{
-				entry = _table + (static_cast<uint8_t>(*src << SrcOffset) | (*(src + 1) >> revSrcOffset));
+				bits |= static_cast<uint64_t>(code->data[i]) << (i << 3);
 			}
 			else
 			{
-				entry = _table + ((*src >> SrcOffset) | static_cast<uint8_t>(*(src + 1) << revSrcOffset));
+				bits |= static_cast<uint64_t>(code->data[i]) << (56 - (i << 3));
 			}
 		}
 
-		bytesRead = 0;
-		while (entry->bitCount == 0)
+		if constexpr (BitEndianness == std::endian::little)
+		{
+			bits &= bitCount == 64 ? UINT64_MAX : (1ull << bitCount) - 1;
+		}
+		else
+		{
+			bits >>= 64 - bitCount;
+		}
+
+		return true;
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	HuffmanDecoder<TSymbol, BitEndianness>::HuffmanDecoder(const TSymbol* symbols, const uint64_t* codeLengths, uint64_t symbolCount, bool multiSymbolTable) :
+		_table(),
+		_multiTable(),
+		_rootBits(1),
+		_maxCodeLength(0)
+	{
+		std::vector<uint64_t> codeValues(symbolCount);
+		bool success = _dsk::huffmanCodeLengthsToCodes(codeLengths, codeValues.data(), symbolCount);
+		assert(success);
+
+		// Sort the codes by length then by symbol order - which is the lexicographic order of canonical codes - with a counting sort
+
+		uint64_t lengthOffsets[66] = {};
+		for (uint64_t i = 0; i < symbolCount; ++i)
 		{
-			if (!entry->next)
+			++lengthOffsets[codeLengths[i] + 1];
+		}
+
+		uint8_t maxLength = 0;
+		for (uint8_t i = 1; i < 65; ++i)
+		{
+			if (lengthOffsets[i + 1])
 			{
-				return false;
+				maxLength = i;
 			}
+			lengthOffsets[i + 1] += lengthOffsets[i];
+		}
 
-			if constexpr (SrcOffset == 0)
+		const uint64_t unusedCount = lengthOffsets[1];
+		const uint64_t codeCount = symbolCount - unusedCount;
+		std::vector<Code> codes(codeCount);
+		for (uint64_t i = 0; i < symbolCount; ++i)
+		{
+			if (codeLengths[i])
 			{
-				entry = entry->next + *(++src);
+				Code& code = codes[lengthOffsets[codeLengths[i]]++ - unusedCount];
+				code.symbol = symbols[i];
+				code.bits = codeValues[i];
+				code.length = codeLengths[i];
 			}
-			else
+		}
+
+		// Fill root table and subtables
+
+		_rootBits = std::clamp<uint8_t>(maxLength, 1, _maxTableBits);
+		_maxCodeLength = maxLength;
+		_table.resize(1 << _rootBits);
+
+		_fillTable(0, _rootBits, 0, codes.data(), codes.data() + codeCount);
+
+		// Chain the root entries: after the first code of an index, the remaining bits of the index may hold complete codes
+
+		if (multiSymbolTable)
+		{
+			const uint32_t rootSize = 1 << _rootBits;
+			_multiTable.resize(rootSize);
+
+			for (uint32_t i = 0; i < rootSize; ++i)
 			{
-				++src;
-				if constexpr (BitEndianness == std::endian::big)
-				{
-					entry = entry->next + (static_cast<uint8_t>(*src << SrcOffset) | (*(src + 1) >> revSrcOffset));
-				}
-				else
+				MultiEntry& multiEntry = _multiTable[i];
+				multiEntry.symbolCount = 0;
+
+				uint8_t bitCount = 0;
+				while (multiEntry.symbolCount < _maxMultiSymbols)
 				{
-					entry = entry->next + ((*src >> SrcOffset) | static_cast<uint8_t>(*(src + 1) << revSrcOffset));
-				}
+					uint32_t index;
+					if constexpr (BitEndianness == std::endian::big)
+					{
+						index = (i << bitCount) & (rootSize - 1);
+					}
+					else
+					{
+						index = i >> bitCount;
+					}
 
+					const Entry& entry = _table[index];
+					if (entry.subtableBits || entry.bitCount == 0 || bitCount + entry.bitCount > _rootBits)
+					{
+						break;
+					}
+
+					bitCount += entry.bitCount;
+					multiEntry.symbols[multiEntry.symbolCount] = entry.symbol;
+					multiEntry.bitCounts[multiEntry.symbolCount] = bitCount;
+					++multiEntry.symbolCount;
+				}
 			}
+		}
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	template<uint8_t SrcOffset>
+	bool HuffmanDecoder<TSymbol, BitEndianness>::readSymbol(TSymbol& symbol, const uint8_t* src, uint64_t& bytesRead, uint8_t& bitsRead) const
+	{
+		uint64_t bitCount = 0;
 
-			++bytesRead;
+		const Entry* entry = _table.data() + _peekBits(src, SrcOffset, _rootBits);
+		while (entry->subtableBits)
+		{
+			bitCount += entry->bitCount;
+			entry = _table.data() + entry->subtableIndex + _peekBits(src, SrcOffset + bitCount, entry->subtableBits);
 		}
 
-		bitsRead = entry->bitCount & 7;
-		bytesRead += entry->bitCount >> 3;
+		if (entry->bitCount == 0)
+		{
+			return false;
+		}
+
+		bitCount += entry->bitCount;
+
+		bytesRead = bitCount >> 3;
+		bitsRead = bitCount & 7;
 		symbol = entry->symbol;
 
 		return true;
@@ -455,8 +730,389 @@ namespace dsk
 	}
 
 	template<typename TSymbol, std::endian BitEndianness>
-	HuffmanDecoder<TSymbol, BitEndianness>::~HuffmanDecoder()
+	uint64_t HuffmanDecoder<TSymbol, BitEndianness>::readSymbols(TSymbol* symbols, uint64_t maxCount, const uint8_t* src, uint64_t srcSize, uint8_t srcOffset, uint64_t& bytesRead, uint8_t& bitsRead) const
+	{
+		assert(srcOffset < 8);
+
+		const uint64_t srcBitCount = srcSize << 3;
+		uint64_t bitOffset = srcOffset;
+		uint64_t count = 0;
+
+		const Entry* const table = _table.data();
+		const MultiEntry* const multiTable = _multiTable.empty() ? nullptr : _multiTable.data();
+		const uint8_t rootBits = _rootBits;
+		const uint8_t maxCodeLength = _maxCodeLength;
+
+		while (count < maxCount && bitOffset < srcBitCount)
+		{
+			const uint64_t remainingBits = srcBitCount - bitOffset;
+
+			// Fast path: load 64 bits at once and decode symbols from them as long as the longest code still fits
+
+			if (remainingBits >= 64 && maxCodeLength <= _maxWindowCodeLength)
+			{
+				const uint64_t window = _loadWindow(src + (bitOffset >> 3), bitOffset & 7);
+				const uint8_t windowBits = 64 - (bitOffset & 7);
+
+				uint8_t windowUsed = 0;
+				while (count < maxCount && windowUsed + maxCodeLength <= windowBits)
+				{
+					const uint32_t rootIndex = _peekWindow(window, windowUsed, rootBits);
+
+					if (multiTable)
+					{
+						const MultiEntry& multiEntry = multiTable[rootIndex];
+						if (multiEntry.symbolCount)
+						{
+							const uint8_t symbolCount = std::min<uint64_t>(multiEntry.symbolCount, maxCount - count);
+							std::copy_n(multiEntry.symbols, symbolCount, symbols + count);
+							count += symbolCount;
+							windowUsed += multiEntry.bitCounts[symbolCount - 1];
+							continue;
+						}
+					}
+
+					uint8_t symbolEnd = windowUsed;
+					const Entry* entry = _readWindowEntry(table, rootBits, window, symbolEnd);
+					if (entry->bitCount == 0)
+					{
+						bitOffset += windowUsed;
+						bytesRead = (bitOffset - srcOffset) >> 3;
+						bitsRead = (bitOffset - srcOffset) & 7;
+						return count;
+					}
+
+					symbols[count++] = entry->symbol;
+					windowUsed = symbolEnd;
+				}
+
+				bitOffset += windowUsed;
+			}
+
+			// Slow path, near the end of src or for very long codes: read a single symbol from a zero-padded copy
+
+			else
+			{
+				uint8_t buffer[16] = {};
+				const uint64_t byteIndex = bitOffset >> 3;
+				std::copy_n(src + byteIndex, std::min<uint64_t>(srcSize - byteIndex, 16), buffer);
+
+				uint64_t symbolBytesRead;
+				uint8_t symbolBitsRead;
+				if (!readSymbol(symbols[count], buffer, bitOffset & 7, symbolBytesRead, symbolBitsRead))
+				{
+					break;
+				}
+
+				const uint64_t symbolBitCount = (symbolBytesRead << 3) + symbolBitsRead;
+				if (symbolBitCount > remainingBits)
+				{
+					break;
+				}
+
+				bitOffset += symbolBitCount;
+				++count;
+			}
+		}
+
+		bytesRead = (bitOffset - srcOffset) >> 3;
+		bitsRead = (bitOffset - srcOffset) & 7;
+
+		return count;
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	bool HuffmanDecoder<TSymbol, BitEndianness>::readStreams(TSymbol* symbols, uint64_t symbolCount, const uint8_t* src, uint64_t srcSize) const
 	{
-		HuffmanTableEntry<TSymbol>::destroyTable(_table);
+		constexpr uint8_t streamCount = _dsk::huffmanStreamCount;
+
+		// Locate the streams from the jump table
+
+		if (srcSize < _dsk::huffmanJumpTableSize)
+		{
+			return false;
+		}
+
+		const uint8_t* streams[streamCount];
+		uint64_t streamSizes[streamCount];
+		TSymbol* outputs[streamCount];
+		uint64_t remainingCounts[streamCount];
+		uint8_t bitOffsets[streamCount] = {};
+
+		uint64_t offset = _dsk::huffmanJumpTableSize;
+		uint64_t firstSymbol = 0;
+		for (uint8_t i = 0; i < streamCount; ++i)
+		{
+			if (i < streamCount - 1)
+			{
+				streamSizes[i] = src[4 * i] | (src[4 * i + 1] << 8) | (src[4 * i + 2] << 16) | (static_cast<uint64_t>(src[4 * i + 3]) << 24);
+				if (streamSizes[i] > srcSize - offset)
+				{
+					return false;
+				}
+			}
+			else
+			{
+				streamSizes[i] = srcSize - offset;
+			}
+
+			streams[i] = src + offset;
+			offset += streamSizes[i];
+
+			outputs[i] = symbols + firstSymbol;
+			remainingCounts[i] = _dsk::huffmanStreamSymbolCount(symbolCount, i);
+			firstSymbol += remainingCounts[i];
+		}
+
+		const Entry* const table = _table.data();
+		const uint8_t rootBits = _rootBits;
+
+		// Decode the streams side by side while they all have a full window and enough symbols left. Each stream is an
+		// independent dependency chain, so the loads and lookups of one stream overlap with those of the others.
+		// A window holds at least 57 bits whatever the bit offset.
+
+		if (_maxCodeLength != 0 && _maxCodeLength <= _maxWindowCodeLength)
+		{
+			const uint8_t symbolsPerWindow = (_maxWindowCodeLength + 1) / _maxCodeLength;
+
+			while (true)
+			{
+				bool canDecode = true;
+				for (uint8_t i = 0; i < streamCount; ++i)
+				{
+					canDecode &= streamSizes[i] >= 8 && remainingCounts[i] >= symbolsPerWindow;
+				}
+
+				if (!canDecode)
+				{
+					break;
+				}
+
+				uint64_t windows[streamCount];
+				uint8_t windowUsed[streamCount] = {};
+				for (uint8_t i = 0; i < streamCount; ++i)
+				{
+					windows[i] = _loadWindow(streams[i], bitOffsets[i]);
+				}
+
+				// The four steps are written explicitly so that the state of each stream stays in registers
+
+				const auto decodeStep = [&](uint8_t i)
+				{
+					const Entry* entry = _readWindowEntry(table, rootBits, windows[i], windowUsed[i]);
+					*(outputs[i]++) = entry->symbol;
+					return entry->bitCount != 0;
+				};
+
+				static_assert(streamCount == 4);
+				for (uint8_t j = 0; j < symbolsPerWindow; ++j)
+				{
+					const bool success0 = decodeStep(0);
+					const bool success1 = decodeStep(1);
+					const bool success2 = decodeStep(2);
+					const bool success3 = decodeStep(3);
+					if (!(success0 && success1 && success2 && success3))
+					{
+						return false;
+					}
+				}
+
+				for (uint8_t i = 0; i < streamCount; ++i)
+				{
+					const uint8_t bitCount = bitOffsets[i] + windowUsed[i];
+					streams[i] += bitCount >> 3;
+					streamSizes[i] -= bitCount >> 3;
+					bitOffsets[i] = bitCount & 7;
+					remainingCounts[i] -= symbolsPerWindow;
+				}
+			}
+		}
+
+		// Decode what remains of each stream one after the other
+
+		for (uint8_t i = 0; i < streamCount; ++i)
+		{
+			uint64_t bytesRead;
+			uint8_t bitsRead;
+			if (readSymbols(outputs[i], remainingCounts[i], streams[i], streamSizes[i], bitOffsets[i], bytesRead, bitsRead) != remainingCounts[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	constexpr uint64_t HuffmanDecoder<TSymbol, BitEndianness>::_peekBits(const uint8_t* src, uint64_t bitOffset, uint8_t bitCount)
+	{
+		assert(bitCount <= _maxTableBits);
+
+		src += bitOffset >> 3;
+		bitOffset &= 7;
+
+		// Only the bytes actually containing the bits are read, so that nothing is read past the longest code
+
+		const uint8_t byteCount = (bitOffset + bitCount + 7) >> 3;
+		const uint64_t filter = (1ULL << bitCount) - 1;
+
+		uint64_t value = 0;
+		if constexpr (BitEndianness == std::endian::big)
+		{
+			for (uint8_t i = 0; i < byteCount; ++i)
+			{
+				value = (value << 8) | src[i];
+			}
+
+			return (value >> ((byteCount << 3) - bitOffset - bitCount)) & filter;
+		}
+		else
+		{
+			for (uint8_t i = 0; i < byteCount; ++i)
+			{
+				value |= static_cast<uint64_t>(src[i]) << (i << 3);
+			}
+
+			return (value >> bitOffset) & filter;
+		}
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	constexpr uint64_t HuffmanDecoder<TSymbol, BitEndianness>::_peekWindow(uint64_t window, uint8_t bitOffset, uint8_t bitCount)
+	{
+		assert(bitCount > 0 && bitOffset + bitCount <= 64);
+
+		if constexpr (BitEndianness == std::endian::big)
+		{
+			return (window << bitOffset) >> (64 - bitCount);
+		}
+		else
+		{
+			return (window >> bitOffset) & ((1ULL << bitCount) - 1);
+		}
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	constexpr uint64_t HuffmanDecoder<TSymbol, BitEndianness>::_loadWindow(const uint8_t* src, uint8_t srcOffset)
+	{
+		assert(srcOffset < 8);
+
+		uint64_t window = 0;
+		if constexpr (BitEndianness == std::endian::big)
+		{
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				window = (window << 8) | src[i];
+			}
+
+			return window << srcOffset;
+		}
+		else
+		{
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				window |= static_cast<uint64_t>(src[i]) << (i << 3);
+			}
+
+			return window >> srcOffset;
+		}
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	auto HuffmanDecoder<TSymbol, BitEndianness>::_readWindowEntry(const Entry* table, uint8_t rootBits, uint64_t window, uint8_t& bitOffset) -> const Entry*
+	{
+		const Entry* entry = table + _peekWindow(window, bitOffset, rootBits);
+		while (entry->subtableBits)
+		{
+			bitOffset += entry->bitCount;
+			entry = table + entry->subtableIndex + _peekWindow(window, bitOffset, entry->subtableBits);
+		}
+
+		bitOffset += entry->bitCount;
+
+		return entry;
+	}
+
+	template<typename TSymbol, std::endian BitEndianness>
+	void HuffmanDecoder<TSymbol, BitEndianness>::_fillTable(uint32_t tableIndex, uint8_t tableBits, uint8_t consumedBits, const Code* codes, const Code* codesEnd)
+	{
+		const uint32_t tableSize = 1 << tableBits;
+		const uint64_t tableFilter = tableSize - 1;
+
+		// Index of a code prefix in a table, depending on the bit order in which the table is read
+
+		const auto prefixToIndex = [](uint64_t prefix, uint8_t prefixBits, uint8_t tableBits) -> uint32_t
+		{
+			if constexpr (BitEndianness == std::endian::big)
+			{
+				return prefix << (tableBits - prefixBits);
+			}
+			else
+			{
+				return _dsk::huffmanReverseCode(prefix, prefixBits);
+			}
+		};
+
+		while (codes != codesEnd)
+		{
+			const uint8_t remainingBits = codes->length - consumedBits;
+
+			// The code ends in this table: fill every entry starting with it
+
+			if (remainingBits <= tableBits)
+			{
+				Entry entry;
+				entry.symbol = codes->symbol;
+				entry.bitCount = remainingBits;
+
+				const uint32_t index = prefixToIndex(codes->bits & ((1ULL << remainingBits) - 1), remainingBits, tableBits);
+				if constexpr (BitEndianness == std::endian::big)
+				{
+					std::fill_n(_table.begin() + tableIndex + index, 1 << (tableBits - remainingBits), entry);
+				}
+				else
+				{
+					for (uint32_t i = index; i < tableSize; i += (1 << remainingBits))
+					{
+						_table[tableIndex + i] = entry;
+					}
+				}
+
+				++codes;
+			}
+
+			// The code is longer than the table: gather all codes sharing the same prefix in a subtable
+
+			else
+			{
+				const uint64_t prefix = (codes->bits >> (remainingBits - tableBits)) & tableFilter;
+
+				uint8_t maxRemainingBits = remainingBits;
+				const Code* groupEnd = codes + 1;
+				for (; groupEnd != codesEnd; ++groupEnd)
+				{
+					const uint8_t groupRemainingBits = groupEnd->length - consumedBits;
+					if (groupRemainingBits <= tableBits || ((groupEnd->bits >> (groupRemainingBits - tableBits)) & tableFilter) != prefix)
+					{
+						break;
+					}
+
+					maxRemainingBits = std::max(maxRemainingBits, groupRemainingBits);
+				}
+
+				const uint32_t subtableIndex = _table.size();
+				const uint8_t subtableBits = std::min<uint8_t>(maxRemainingBits - tableBits, _maxTableBits);
+				_table.resize(_table.size() + (1 << subtableBits));
+
+				Entry& link = _table[tableIndex + prefixToIndex(prefix, tableBits, tableBits)];
+				link.subtableIndex = subtableIndex;
+				link.bitCount = tableBits;
+				link.subtableBits = subtableBits;
+
+				_fillTable(subtableIndex, subtableBits, consumedBits + tableBits, codes, groupEnd);
+
+				codes = groupEnd;
+			}
+		}
 	}
 }
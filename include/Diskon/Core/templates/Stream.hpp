@@ -273,6 +273,7 @@ namespace dsk
 				// Read directly into result data
 
 				uint64_t readSize = _read(_handle, it, remainingSize);
+				_sizeReadFromHandle += readSize;
 				if (readSize != remainingSize)
 				{
 					if (_eof(_handle))
@@ -302,6 +303,7 @@ namespace dsk
 				// Read a new buffer from handle
 
 				readSize = _read(_handle, _bufferBeginBuffer, _bufferSize);
+				_sizeReadFromHandle += readSize;
 				if (readSize != _bufferSize)
 				{
 					DSK_CHECK(_eof(_handle), "Error while reading from handle.");
@@ -644,6 +646,11 @@ namespace dsk
 		return _cursor == _bufferEnd && _eof(_handle);
 	}
 
+	inline uint64_t IStream::getBitPosition() const
+	{
+		return ((_sizeReadFromHandle - std::distance<const uint8_t*>(_cursor, _bufferEnd)) << 3) + _bitCursor;
+	}
+
 	constexpr void IStream::setByteEndianness(std::endian endianness)
 	{
 		_byteEndianness = endianness;
@@ -18,14 +18,32 @@ namespace dsk
 			enum class CompressionType : uint8_t
 			{
 				NoCompression	= 0b00,
-				FixedHuffman	= 0b10,
-				DynamicHuffman	= 0b01
+				FixedHuffman	= 0b01,
+				DynamicHuffman	= 0b10
+			};
+
+			enum class FlushMode : uint8_t
+			{
+				Sync,	// Align the output on a byte, so that all the data written so far can be decoded
+				Full	// Also forget the history, so that decoding can start right after the flush
+			};
+
+			enum class Strategy : uint8_t
+			{
+				Default,		// Look for repetitions as set by the level
+				HuffmanOnly,	// Only write literals, which suits data already filtered, as PNG scanlines
+				Rle				// Only look for repetitions of the previous byte, as runs of pixels of the same value
 			};
 		
 			struct BlockHeader
 			{
 				bool isFinal;
 				CompressionType compressionType;
+
+				/*
+				* For DynamicHuffman, if all the code lengths are 0, DeflateOStream chooses the blocks itself: the data is
+				* split where its statistics change, and each block is stored, fixed or dynamic, whichever is the smallest.
+				*/
 				uint8_t litlenCodeLengths[288];
 				uint8_t distCodeLengths[32];
 			};
@@ -40,6 +58,115 @@ namespace dsk
 			{
 				std::vector<Block> blocks;
 			};
+
+			// State of a DeflateIStream at the beginning of a block, from which decoding can restart
+			struct Checkpoint
+			{
+				uint64_t bitPosition;			// Position of the block in the input stream (see IStream::getBitPosition)
+				uint64_t outputPosition;		// Number of bytes decoded before the block
+				bool isWindowCompressed;
+				std::vector<uint8_t> window;	// The last bytes decoded before the block, up to 32 KiB, deflated if isWindowCompressed
+			};
+
+			struct Index
+			{
+				std::vector<Checkpoint> checkpoints;	// By increasing positions
+			};
+
+			// Get the last checkpoint at or before outputPosition, nullptr if there is none
+			DSK_API const Checkpoint* findCheckpoint(const Index& index, uint64_t outputPosition);
+
+			// State of a DeflateIStream between two calls, from which another DeflateIStream can go on decoding
+			struct IStreamState
+			{
+				uint64_t bitPosition;			// Position of the next bit to read in the input stream
+				uint64_t outputPosition;		// Number of bytes given since the beginning of the stream
+				bool readingBlock;
+				BlockHeader header;				// Header of the block being read, if readingBlock
+				uint16_t remainingSize;			// Bytes left in the stored block being read
+				bool endOfBlockRead;			// The end of the compressed block being read was decoded
+				std::vector<uint8_t> window;	// The last bytes given, up to 32 KiB, then the bytes decoded but not given yet
+				uint32_t pendingSize;			// Number of bytes decoded but not given yet, at the end of window
+			};
+
+			// State of a DeflateOStream right after a sync flush, from which another DeflateOStream can go on encoding
+			struct OStreamState
+			{
+				uint64_t inputPosition;			// Number of bytes given since the beginning of the stream
+				bool writingBlock;				// A block with automatic codes is being written
+				bool writingLastBlock;
+				uint8_t level;
+				Strategy strategy;
+				std::vector<uint8_t> window;	// The last bytes given, up to 32 KiB
+			};
+
+			// Blocks of a deflate stream decoded without the data preceding them
+			struct Chunk
+			{
+				uint64_t beginBitPosition;		// Position of the first block in the input stream
+				uint64_t endBitPosition;		// Position of the block following the chunk, or of the end of the stream
+				bool isLast;					// The chunk ends with the final block
+				std::vector<uint16_t> data;		// Decoded bytes, or 256 + i for the byte i of the 32 KiB preceding the chunk
+			};
+
+			/*
+			* Get the position of the first bit in [bitPosition, endBitPosition) that looks like the beginning of a non-final
+			* block with dynamic codes, endBitPosition if there is none. The header must be valid and describe complete codes,
+			* which is rare enough at random positions. Blocks with fixed codes and stored blocks are not found.
+			*/
+			DSK_API uint64_t findBlockStart(std::span<const uint8_t> src, uint64_t bitPosition, uint64_t endBitPosition);
+
+			/*
+			* Write the bytes of chunk to dst, taking the bytes it references before it from window, which holds the data
+			* preceding the chunk. dst must hold chunk.data.size() bytes.
+			*/
+			DSK_API void resolveChunk(const Chunk& chunk, std::span<const uint8_t> window, std::span<uint8_t> dst, ruc::Status& status);
+
+			// Call task(i) for each i in [0, taskCount) and return once all calls are done, possibly running them in parallel
+			using TaskRunner = std::function<void(uint64_t taskCount, const std::function<void(uint64_t)>& task)>;
+
+			/*
+			* Decode a whole deflate stream like inflate, splitting src in chunks of about chunkSize bytes which are decoded
+			* independently by the tasks given to runTasks:
+			* - a block start is searched for in each chunk with findBlockStart,
+			* - each chunk is decoded up to the block start of the next one with DeflateIStream::readChunk,
+			* - the last 32 KiB of each chunk are resolved one chunk after the other, which gives the data referenced by
+			* the following chunk, then the rest of the chunks are resolved.
+			* If the chunks do not follow each other, because a block start was wrongly guessed, the stream is decoded by
+			* inflate. Tasks run one after the other if runTasks is empty.
+			*/
+			DSK_API uint64_t inflateChunks(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint64_t chunkSize, const TaskRunner& runTasks = {});
+
+			/*
+			* Decode a whole deflate stream from memory to memory and return the decoded size, fails if dst is too small.
+			* dictionary holds the data the stream was encoded after (see deflatePart).
+			*/
+			DSK_API uint64_t inflate(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, std::span<const uint8_t> dictionary = {});
+
+			/*
+			* Encode src in a single final block with automatic codes (see BlockHeader) and return the encoded size.
+			* dst is always large enough if it holds deflateBound(src.size()) bytes.
+			*/
+			DSK_API uint64_t deflate(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint8_t level = 6, Strategy strategy = Strategy::Default);
+			DSK_API uint64_t deflateBound(uint64_t srcSize);
+
+			/*
+			* Encode src as one of the consecutive parts of a deflate stream, so that the parts can be encoded in parallel
+			* and concatenated. dictionary holds the data preceding src, of which the last 32 KiB are referenced. The parts
+			* but the last one end with an empty stored block, which aligns them on a byte. The checksums of the parts can
+			* be joined with combine (see Hash.hpp).
+			*/
+			DSK_API uint64_t deflatePart(std::span<const uint8_t> src, std::span<const uint8_t> dictionary, bool isLast, std::span<uint8_t> dst, ruc::Status& status, uint8_t level = 6, Strategy strategy = Strategy::Default);
+			DSK_API uint64_t deflatePartBound(uint64_t srcSize);
+
+			/*
+			* Encode src like deflate, splitting it in chunks of chunkSize bytes which are encoded independently with
+			* deflatePart by the tasks given to runTasks, each chunk referencing the 32 KiB preceding it. The parts are then
+			* joined in dst, which is always large enough if it holds deflateChunksBound(src.size(), chunkSize) bytes.
+			* Tasks run one after the other if runTasks is empty.
+			*/
+			DSK_API uint64_t deflateChunks(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint64_t chunkSize, uint8_t level = 6, Strategy strategy = Strategy::Default, const TaskRunner& runTasks = {});
+			DSK_API uint64_t deflateChunksBound(uint64_t srcSize, uint64_t chunkSize);
 		}
 		
 		class DSK_API DeflateIStream : public FormatIStream
@@ -58,19 +185,108 @@ namespace dsk
 				void readBlockHeader(deflate::BlockHeader& header);
 				void readBlockData(uint8_t* data, uint64_t size, uint64_t& sizeRead);
 				void readBlockEnd();
+
+				/*
+				* Decode the whole stream to build an index of checkpoints at the beginning of blocks, separated by at least
+				* interval decoded bytes. The windows of the checkpoints are deflated if compressWindows is set.
+				*/
+				void readIndex(deflate::Index& index, uint64_t interval, bool compressWindows = false);
+
+				// Let the next stream reference data preceding it, must be called before its first block
+				void setDictionary(const uint8_t* data, uint64_t size);
+
+				/*
+				* Set the number of bytes the next streams can go back to, a power of 2 from 256 to 32768 (the default), to
+				* keep less history for streams announcing a smaller window. Must be called before the first block and before
+				* setDictionary.
+				*/
+				void setWindowSize(uint32_t windowSize);
+
+				/*
+				* Restart decoding from a checkpoint, the next call being readBlockHeader. The input stream must be positioned
+				* on the byte holding the checkpoint's bitPosition, the bits of this byte before the block are skipped.
+				*/
+				void seek(const deflate::Checkpoint& checkpoint);
+
+				/*
+				* Get the state of the stream, to go on decoding later, possibly in another process, without decoding the
+				* data before again. The state can be taken anywhere between two calls.
+				*/
+				void saveState(deflate::IStreamState& state) const;
+
+				/*
+				* Go on decoding from a state given by saveState, instead of the beginning of a stream. The input stream must
+				* be positioned on the byte holding the state's bitPosition, the bits of this byte before it are skipped.
+				*/
+				void restoreState(const deflate::IStreamState& state);
+
+				/*
+				* Decode blocks from chunk.beginBitPosition until the first block starting at endBitPosition or after, or until
+				* the final block. The input stream must be positioned on the byte holding chunk.beginBitPosition, and the
+				* references before the chunk are kept as markers (see deflate::Chunk).
+				*/
+				void readChunk(deflate::Chunk& chunk, uint64_t endBitPosition);
 		
-				~DeflateIStream();
+				~DeflateIStream() = default;
 		
 			private:
+
+				enum class DecodeType : uint8_t
+				{
+					Invalid,
+					Literal,
+					EndOfBlock,
+					Base,		// Base of a length or of a distance, followed by extraBits bits to add to it
+					Subtable
+				};
+
+				/*
+				* Entry of the decoding tables, indexed by the next bits of the stream. The codes longer than the root bits
+				* continue in a subtable, indexed by the bits following the root bits.
+				*/
+				struct DecodeEntry
+				{
+					uint16_t value;		// Literal, base, or index of the subtable
+					DecodeType type;
+					uint8_t codeLength;	// Including the root bits for the entries of subtables
+					uint8_t extraBits;	// Bits indexing the subtable for a link to a subtable
+				};
+
+				struct FixedTables
+				{
+					std::vector<DecodeEntry> litlen;
+					std::vector<DecodeEntry> dist;
+				};
 		
 				void setStreamState() override final;
 				void resetFormatState() override final;
 
-				static constexpr uint16_t _windowSize = 32768;
-				static constexpr uint16_t _windowIndexFilter = _windowSize - 1;
-		
-				HuffmanDecoder<uint16_t, std::endian::little>* _litlenDecoder;
-				HuffmanDecoder<uint8_t, std::endian::little>* _distDecoder;
+				static bool _buildDecodeTable(const uint64_t* codeLengths, uint16_t symbolCount, bool isDistance, uint8_t rootBits, std::vector<DecodeEntry>& table);
+				static const FixedTables& _getFixedTables();
+				void _decodeInWindow(uint64_t size);
+				template<typename TOutput> void _decodeSymbols(TOutput* dst, uint64_t& dstIndex, uint64_t endIndex, const TOutput* history, uint32_t historySize);
+				void _slideWindow();
+				void _appendToWindow(const uint8_t* data, uint64_t size);
+				void _skipToBit(uint64_t bitPosition);
+
+				static constexpr uint32_t _maxWindowSize = 32768;
+				static constexpr uint16_t _maxMatchLength = 258;
+				static constexpr uint8_t _litlenRootBits = 10;
+				static constexpr uint8_t _distRootBits = 8;
+				static constexpr uint8_t _codeLengthRootBits = 7;
+				static constexpr uint8_t _maxSymbolBitCount = 15 + 5 + 15 + 13;	// Longest length code and distance code with their extra bits
+				static constexpr uint8_t _minPeekSize = 16;
+				static constexpr uint64_t _minDirectOutputSize = 65536;
+
+				// Tables of the current compressed block, either the fixed ones shared by all streams or the dynamic ones
+				const DecodeEntry* _litlenTable;
+				const DecodeEntry* _distTable;
+				uint8_t _codeLengths[320];	// Literal/length then distance code lengths of the current dynamic block
+
+				// Storage of the dynamic tables, rebuilt in place for each block
+				std::vector<DecodeEntry> _dynamicLitlenTable;
+				std::vector<DecodeEntry> _dynamicDistTable;
+				std::vector<DecodeEntry> _codeLengthTable;
 
 				bool _readingBlock;
 
@@ -84,11 +300,10 @@ namespace dsk
 				};
 
 				uint64_t _bytesRead;
-				uint8_t _window[_windowSize];
-				uint16_t _windowIndex;
-
-				uint16_t _repeaterDistance;
-				uint16_t _remainingRepeats;
+				uint32_t _windowSize;			// Number of bytes the distances can go back to
+				std::vector<uint8_t> _window;	// The history then the decoded data, over two window sizes
+				uint32_t _windowIndex;			// Position in _window of the next decoded byte
+				uint32_t _outputIndex;			// Position in _window of the next decoded byte to give
 		};
 		
 		class DSK_API DeflateOStream : public FormatOStream
@@ -107,30 +322,161 @@ namespace dsk
 				void writeBlockHeader(const deflate::BlockHeader& header, uint16_t size = 0);
 				void writeBlockData(const uint8_t* data, uint64_t size);
 				void writeBlockEnd();
+
+				/*
+				* Set the effort spent looking for repetitions in compressed blocks, from 1 (fastest) to 9 (smallest output),
+				* as zlib levels do. The default level is 6. Level 10 chooses the repetitions by optimal parsing, which is
+				* many times slower and gives a smaller output.
+				*/
+				void setLevel(uint8_t level);
+
+				/*
+				* Set how compressed blocks look for repetitions, for the data compressed after the call. HuffmanOnly and Rle
+				* do not search the history, which makes them many times faster than the levels, and ignore the level.
+				*/
+				void setStrategy(deflate::Strategy strategy);
+
+				// Let the next stream reference data preceding it, must be called before its first block
+				void setDictionary(const uint8_t* data, uint64_t size);
+
+				/*
+				* Write all the data given so far followed by an empty stored block, then flush the output stream. Must be
+				* called between blocks of a stream, or while writing a block with automatic codes, which then goes on in a
+				* new block.
+				*/
+				void flush(deflate::FlushMode mode);
+
+				/*
+				* Flush the stream as flush(FlushMode::Sync) does and get its state, to go on encoding later, possibly in
+				* another process. Must be called where flush can be.
+				*/
+				void saveState(deflate::OStreamState& state);
+
+				/*
+				* Go on encoding from a state given by saveState, instead of the beginning of a stream. The output stream must
+				* continue the output written up to the state. Must be called before the first block.
+				*/
+				void restoreState(const deflate::OStreamState& state);
 		
-				~DeflateOStream();
+				~DeflateOStream() = default;
 		
 			private:
+
+				// A literal if distance is 0, otherwise a match of length bytes
+				struct Symbol
+				{
+					uint16_t litlenOrLength;
+					uint16_t distance;
+				};
+
+				struct Match
+				{
+					uint16_t length;
+					uint16_t distance;
+				};
+
+				// Code of a symbol with its bits in the order they are written, the symbol having no code if length is 0
+				struct Code
+				{
+					uint16_t bits;
+					uint8_t length;
+				};
+
+				struct Codes
+				{
+					Code litlen[288];
+					Code dist[32];
+				};
+
+				// Cheapest way found to reach a position of an optimal parsing segment, from the position length bytes before
+				struct PathNode
+				{
+					uint32_t cost;
+					uint16_t length;
+					uint16_t distance;	// 0 for a literal
+				};
 		
 				void setStreamState() override final;
 				void resetFormatState() override final;
 
+				void _appendToWindow(const uint8_t* data, uint64_t size, uint64_t& sizeAppended);
+				void _slideWindow();
+				void _resetWindow();
+				void _updateHash(uint32_t end);
+				uint16_t _findMatch(uint32_t position, uint16_t minLength, uint16_t& distance);
+				void _findMatches(uint32_t position);
+				uint16_t _getEncodableLength(uint16_t length, uint16_t distance) const;
+				void _compress(bool flush);
+				void _compressOptimally(bool flush);
+				void _compressRuns(bool flush);
+				void _findCheapestPath(uint32_t size, const uint8_t* codeLengths);
+				void _checkBlockEnd();
+				void _writeSymbols();
+				static void _computeCodes(const uint64_t* codeLengths, uint16_t symbolCount, Code* codes);
+				static const Codes& _getFixedCodes();
+				void _setCodes(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths);
+				void _setFixedCodes();
+				void _writeDynamicHeader(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths);
+				void _writeAutomaticBlock(bool isFinal);
+				void _startAutomaticBlock();
+				void _pushLiteral(uint8_t literal);
+				void _pushMatch(uint16_t length, uint16_t distance);
+				bool _shouldEndBlock();
+
 				static constexpr uint16_t _windowSize = 32768;
 				static constexpr uint16_t _windowIndexFilter = _windowSize - 1;
 
-				HuffmanEncoder<uint16_t, std::endian::little>* _litlenEncoder;
-				HuffmanEncoder<uint8_t, std::endian::little>* _distEncoder;
+				static constexpr uint16_t _minMatchLength = 3;
+				static constexpr uint16_t _maxMatchLength = 258;
+				static constexpr uint16_t _minLookahead = _maxMatchLength + _minMatchLength + 1;
+				static constexpr uint16_t _maxDistance = _windowSize - _minLookahead;
+				static constexpr uint8_t _hashBits = 15;
+				static constexpr uint32_t _hashSize = 1 << _hashBits;
+				static constexpr uint64_t _maxSymbolCount = 16384;
+				static constexpr uint8_t _observationTypeCount = 10;
+				static constexpr uint16_t _observationsPerCheck = 512;
+				static constexpr uint32_t _maxStoredBlockSize = _windowSize - 2 * _minLookahead;	// Larger blocks may have left the window
+				static constexpr uint32_t _optimalSegmentSize = 32768;
+				static constexpr uint8_t _optimalPassCount = 4;
+
+				const Codes* _codes;	// Codes of the current compressed block, either the fixed ones shared by all streams or _dynamicCodes
+				Codes _dynamicCodes;
 
 				bool _writingBlock;
 
 				bool _writingLastBlock;
 				bool _currentBlockCompressed;
+				bool _automaticCodes;	// True if the codes of the current block are computed from its symbols
 
 				uint16_t _currentBlockRemainingSize;
 
+				uint8_t _level;
+				deflate::Strategy _strategy;
+
 				uint64_t _bytesWritten;
-				uint8_t _window[_windowSize];
-				uint16_t _windowIndex;
+				std::vector<uint8_t> _window;		// The history then the data not compressed yet, over two window sizes
+				uint32_t _windowIndex;				// Position in _window of the next byte to compress
+				uint32_t _lookahead;				// Number of bytes not compressed yet
+				uint32_t _hashIndex;				// Position in _window of the next byte to insert in the hash chains
+				std::vector<uint16_t> _hashHeads;	// Last position of each hash of three bytes, 0 if none
+				std::vector<uint16_t> _hashChains;	// Previous position with the same hash, indexed by position modulo the window size
+
+				std::vector<Symbol> _symbols;
+
+				// Buffers of the optimal parsing, only used by the highest level
+				std::vector<Match> _matches;			// Matches of each position of the segment, by increasing lengths and distances
+				std::vector<uint32_t> _matchOffsets;	// Index in _matches of the first match of each position
+				std::vector<PathNode> _pathNodes;
+				std::vector<Symbol> _path;
+
+				// Statistics of the current block with automatic codes, to decide where to end it
+				uint64_t _blockSize;
+				bool _blockBytesAvailable;	// False once the beginning of the block left the window
+				uint64_t _blockFixedBitCount;	// Size of the symbols of the block with the fixed codes
+				uint32_t _observations[_observationTypeCount];
+				uint32_t _newObservations[_observationTypeCount];
+				uint32_t _observationCount;
+				uint32_t _newObservationCount;
 		};
 	}
 }
@@ -79,3 +79,4 @@ namespace dsk
 
 #define DSKFMT_BEGIN()					assert(_stream); assert(_stream->getStatus()); assert(_status)
 #define DSKFMT_STREAM_CALL(func, ...)	_stream->func(__VA_ARGS__); RUC_RELAYCOPY(_stream->getStatus(), _status, RUC_VOID)
+#define DSKFMT_SUBSTREAM_CALL(subStream, func, ...)	subStream->func(__VA_ARGS__); RUC_RELAYCOPY(subStream->getStatus(), _status, RUC_VOID)
@@ -13,94 +13,114 @@ namespace dsk
 {
 	namespace fmt
 	{
-		// namespace zlib
-		// {
-		// 	enum class CompressionMethod : uint8_t
-		// 	{
-		// 		Deflate = 0x8
-		// 	};
-		// 
-		// 	enum class CompressionLevel : uint8_t
-		// 	{
-		// 		FastestAlgorithm	= 0b00,
-		// 		FastAlgorithm		= 0b01,
-		// 		DefaultAlgorithm	= 0b10,
-		// 		MaximumCompression	= 0b11
-		// 	};
-		// 
-		// 	struct Header
-		// 	{
-		// 		CompressionMethod compressionMethod;
-		// 		uint8_t compressionInfo;
-		// 		CompressionLevel compressionLevel;
-		// 		std::optional<uint32_t> dictId;
-		// 	};
-		// 
-		// 	struct File
-		// 	{
-		// 		Header header;
-		// 		std::vector<uint8_t> data;
-		// 	};
-		// }
-		// 
-		// class ZlibIStream : public FormatIStream
-		// {
-		// 	public:
-		// 
-		// 		ZlibIStream();
-		// 		ZlibIStream(const ZlibIStream& stream) = delete;
-		// 		ZlibIStream(ZlibIStream&& stream) = delete;
-		// 
-		// 		ZlibIStream& operator=(const ZlibIStream& stream) = delete;
-		// 		ZlibIStream& operator=(ZlibIStream&& stream) = delete;
-		// 
-		// 		const ruc::Status& readFile(zlib::File& file);
-		// 		const ruc::Status& readHeader(zlib::Header& header);
-		// 		const ruc::Status& readData(void* data, uint64_t size, uint64_t& sizeRead);
-		// 		const ruc::Status& readEndFile();
-		// 
-		// 		~ZlibIStream() = default;
-		// 
-		// 	private:
-		// 
-		// 		void onSourceRemoved() override final;
-		// 
-		// 		DeflateIStream* _deflateStream;
-		// 
-		// 		bool _headerRead;
-		// 		bool _readingLastBlock;
-		// 
-		// 		uint32_t _checksum;
-		// };
-		// 
-		// class ZlibOStream : public FormatOStream
-		// {
-		// 	public:
-		// 
-		// 		ZlibOStream();
-		// 		ZlibOStream(const ZlibOStream& stream) = delete;
-		// 		ZlibOStream(ZlibOStream&& stream) = delete;
-		// 
-		// 		ZlibOStream& operator=(const ZlibOStream& stream) = delete;
-		// 		ZlibOStream& operator=(ZlibOStream&& stream) = delete;
-		// 
-		// 		const ruc::Status& writeFile(const zlib::File& file);
-		// 		const ruc::Status& writeHeader(const zlib::Header& header, const deflate::BlockHeader& firstBlockHeader);
-		// 		const ruc::Status& writeData(const void* data, uint64_t size, deflate::BlockHeader* blockHeader = nullptr);
-		// 		const ruc::Status& writeEndFile();
-		// 
-		// 		~ZlibOStream() = default;
-		// 
-		// 	private:
-		// 
-		// 		void onDestinationRemoved() override final;
-		// 
-		// 		DeflateOStream* _deflateStream;
-		// 
-		// 		bool _headerWritten;
-		// 		deflate::BlockHeader _lastBlockHeader;
-		// 		
-		// 		uint32_t _checksum;
-		// };
+		namespace zlib
+		{
+			enum class CompressionMethod : uint8_t
+			{
+				Deflate = 0x8
+			};
+
+			enum class CompressionLevel : uint8_t
+			{
+				FastestAlgorithm	= 0b00,
+				FastAlgorithm		= 0b01,
+				DefaultAlgorithm	= 0b10,
+				MaximumCompression	= 0b11
+			};
+
+			struct Header
+			{
+				CompressionMethod compressionMethod;
+				uint8_t compressionInfo;			// Base 2 logarithm of the window size minus 8, always written as 7
+				CompressionLevel compressionLevel;	// Only informative
+				std::optional<uint32_t> dictId;		// Adler-32 of the preset dictionary, if any
+			};
+
+			struct File
+			{
+				Header header;
+				std::vector<uint8_t> data;
+			};
+		}
+
+		class DSK_API ZlibIStream : public FormatIStream
+		{
+			public:
+
+				ZlibIStream(IStream* stream);
+				ZlibIStream(const ZlibIStream& stream) = delete;
+				ZlibIStream(ZlibIStream&& stream) = delete;
+
+				ZlibIStream& operator=(const ZlibIStream& stream) = delete;
+				ZlibIStream& operator=(ZlibIStream&& stream) = delete;
+
+				void readFile(zlib::File& file);
+				void readHeader(zlib::Header& header);
+
+				// Give the preset dictionary announced by the header, must be called after readHeader if header.dictId is set
+				void setDictionary(const uint8_t* data, uint64_t size);
+
+				/*
+				* Read up to size bytes of the data following the header, across the deflate blocks. sizeRead is less than
+				* size only at the end of the data. The checksum is updated as the data is read.
+				*/
+				void readData(uint8_t* data, uint64_t size, uint64_t& sizeRead);
+				void readEndFile();
+
+				~ZlibIStream();
+
+			private:
+
+				void setStreamState() override final;
+				void resetFormatState() override final;
+
+				bool _headerRead;
+				std::optional<uint32_t> _missingDictId;	// Id of the dictionary announced by the header and not given yet
+				bool _readingBlock;
+				bool _readingLastBlock;
+				bool _dataEnded;
+				uint32_t _checksum;
+
+				DeflateIStream* _deflateStream;
+		};
+
+		class DSK_API ZlibOStream : public FormatOStream
+		{
+			public:
+
+				ZlibOStream(OStream* stream);
+				ZlibOStream(const ZlibOStream& stream) = delete;
+				ZlibOStream(ZlibOStream&& stream) = delete;
+
+				ZlibOStream& operator=(const ZlibOStream& stream) = delete;
+				ZlibOStream& operator=(ZlibOStream&& stream) = delete;
+
+				void writeFile(const zlib::File& file);
+
+				// Write the header then start the data, in deflate blocks with automatic codes (see deflate::BlockHeader)
+				void writeHeader(const zlib::Header& header);
+				void writeData(const uint8_t* data, uint64_t size);
+				void writeEndFile();
+
+				// See DeflateOStream::setLevel and DeflateOStream::setStrategy
+				void setLevel(uint8_t level);
+				void setStrategy(deflate::Strategy strategy);
+
+				// Set the preset dictionary of the next stream, must be called before writeHeader, whose dictId must then be its Adler-32
+				void setDictionary(const uint8_t* data, uint64_t size);
+
+				~ZlibOStream();
+
+			private:
+
+				void setStreamState() override final;
+				void resetFormatState() override final;
+
+				bool _headerWritten;
+				std::optional<uint32_t> _dictId;
+				uint32_t _checksum;
+
+				DeflateOStream* _deflateStream;
+		};
 	}
 }
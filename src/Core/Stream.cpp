@@ -22,6 +22,7 @@ namespace dsk
 		_bufferEnd(_buffer + _keepSize + _bufferSize),
 		_cursor(_bufferEnd),
 		_bitCursor(0),
+		_sizeReadFromHandle(0),
 		_byteEndianness(std::endian::native),
 		_bitEndianness(std::endian::little)
 	{
@@ -182,6 +183,49 @@ namespace dsk
 		}
 	}
 
+	void IStream::bitPeek(const uint8_t*& data, uint64_t& size, uint8_t& bitOffset, uint64_t minSize)
+	{
+		assert(_status);
+		assert(minSize <= _keepSize);
+
+		// Refill the buffer only if the end of the handle was not reached, the remaining bytes are in the "keep data"
+
+		const uint64_t remainingSize = std::distance(_cursor, _bufferEnd);
+		if (remainingSize < minSize && _bufferEnd == _bufferBeginBuffer + _bufferSize)
+		{
+			std::copy(_bufferBeginRetrieve, _bufferEnd, _buffer);
+
+			const uint64_t readSize = _read(_handle, _bufferBeginBuffer, _bufferSize);
+			_sizeReadFromHandle += readSize;
+			if (readSize != _bufferSize)
+			{
+				DSK_CHECK(_eof(_handle), "Error while reading from handle.");
+
+				_bufferEnd = _bufferBeginBuffer + readSize;
+			}
+
+			_cursor = _bufferBeginBuffer - remainingSize;
+		}
+
+		data = _cursor;
+		size = std::distance(_cursor, _bufferEnd);
+		bitOffset = _bitCursor;
+	}
+
+	void IStream::bitSkip(uint64_t bitCount)
+	{
+		assert(_status);
+
+		const uint64_t totalBitCount = bitCount + _bitCursor;
+		const uint64_t size = totalBitCount >> 3;
+		const uint64_t sizeAvailable = std::distance(_cursor, _bufferEnd);
+
+		DSK_CHECK(size < sizeAvailable || (size == sizeAvailable && (totalBitCount & 7) == 0), "Tried to skip more bits than what was peeked.");
+
+		_cursor += size;
+		_bitCursor = totalBitCount & 7;
+	}
+
 	void IStream::finishByte()
 	{
 		assert(_status);
@@ -214,6 +258,7 @@ namespace dsk
 		// Read the new buffer from handle
 
 		const uint64_t readSize = _read(_handle, _bufferBeginBuffer, _bufferSize);
+		_sizeReadFromHandle += readSize;
 		if (readSize != _bufferSize)
 		{
 			DSK_CHECK(_eof(_handle), "Error while reading from handle.");
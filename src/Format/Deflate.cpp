@@ -13,72 +13,605 @@ namespace dsk
 	{
 		namespace
 		{
-			/*
-			* Sort according codeLengths in ascending order, and copy each operation on symbols to keep the associations (symbol, codeLength)
-			* 0 is the highest code length, not the lowest
-			* symbolCount at the end of the function is the number of symbol that have non-zero code length
-			*/
-			template<typename TSymbol>
-			void sortCodeLengths(TSymbol* symbols, uint8_t* codeLengths, uint16_t& symbolCount)
+			// Code lengths of the fixed Huffman codes (RFC 1951, 3.2.6)
+			constexpr std::array<uint8_t, 320> fixedCodeLengths = []()
 			{
-				// We check "the real end" because deflate creates a lot of 0s at the end of the codeLengths array
+				std::array<uint8_t, 320> codeLengths;
+				std::fill_n(codeLengths.begin(), 144, 8);
+				std::fill_n(codeLengths.begin() + 144, 256 - 144, 9);
+				std::fill_n(codeLengths.begin() + 256, 280 - 256, 7);
+				std::fill_n(codeLengths.begin() + 280, 288 - 280, 8);
+				std::fill_n(codeLengths.begin() + 288, 32, 5);
+				return codeLengths;
+			}();
+
+			// Base values and extra bits of the length symbols (257 to 285) and of the distance symbols (RFC 1951, 3.2.5)
+			constexpr uint8_t lenExtraBits[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			constexpr uint16_t lenStart[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			constexpr uint8_t distExtraBits[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+			constexpr uint16_t distStart[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+			// Length symbol minus 257 of each match length
+			constexpr std::array<uint8_t, 259> lenCodes = []()
+			{
+				std::array<uint8_t, 259> codes{};
+				for (uint8_t i = 0; i < 29; ++i)
+				{
+					for (uint16_t length = lenStart[i]; length < lenStart[i] + (1 << lenExtraBits[i]) && length <= 258; ++length)
+					{
+						codes[length] = i;
+					}
+				}
+				return codes;
+			}();
+
+			// Distance symbol of each distance, indexed by distance - 1 up to 256 and by 256 + (distance - 1) / 128 above
+			constexpr std::array<uint8_t, 512> distCodes = []()
+			{
+				std::array<uint8_t, 512> codes{};
+				for (uint8_t i = 0; i < 30; ++i)
+				{
+					for (uint32_t distance = distStart[i]; distance < distStart[i] + (1u << distExtraBits[i]); ++distance)
+					{
+						codes[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)] = i;
+					}
+				}
+				return codes;
+			}();
+
+			constexpr uint8_t getDistCode(uint16_t distance)
+			{
+				return distCodes[distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7)];
+			}
+
+			enum class MatchStrategy : uint8_t
+			{
+				Greedy,	// Take the longest match at the current position
+				Lazy,	// Write a literal instead if the next position has a longer match
+				Lazy2,	// Also look two positions ahead
+				Optimal	// Choose the cheapest sequence of literals and matches of whole segments
+			};
+
+			struct LevelConfig
+			{
+				uint16_t goodLength;	// Search only a quarter of the chain when already holding a match this long
+				uint16_t maxLazy;		// Do not look further for a match this long, or do not hash its bytes if greedy
+				uint16_t niceLength;	// Stop searching when a match this long is found
+				uint16_t maxChain;		// Number of positions of the hash chain tried
+				MatchStrategy strategy;
+			};
+
+			constexpr LevelConfig levelConfigs[] =
+			{
+				{ 0, 0, 0, 0, MatchStrategy::Greedy },
+				{ 4, 4, 8, 4, MatchStrategy::Greedy },
+				{ 4, 5, 16, 8, MatchStrategy::Greedy },
+				{ 4, 6, 32, 32, MatchStrategy::Greedy },
+				{ 4, 4, 16, 16, MatchStrategy::Lazy },
+				{ 8, 16, 32, 32, MatchStrategy::Lazy },
+				{ 8, 16, 128, 128, MatchStrategy::Lazy },
+				{ 8, 32, 128, 256, MatchStrategy::Lazy },
+				{ 32, 128, 258, 1024, MatchStrategy::Lazy2 },
+				{ 32, 258, 258, 4096, MatchStrategy::Lazy2 },
+				{ 32, 258, 258, 4096, MatchStrategy::Optimal }
+			};
+
+			// Matches of the minimum length further than this cost more than their literals
+			constexpr uint16_t tooFarDistance = 4096;
+
+			// Blocks with automatic codes are not split before this size
+			constexpr uint32_t minSplitBlockSize = 10000;
+
+			constexpr uint8_t codeLengthsOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			// Write bits in little endian order to a byte buffer, through an accumulator flushed 32 bits at a time
+			struct BitAccumulator
+			{
+				// Values are at most 32 bits long
+				void append(uint64_t value, uint8_t valueBitCount)
+				{
+					bits |= value << bitCount;
+					bitCount += valueBitCount;
+					if (bitCount >= 32)
+					{
+						dst[byteCount] = bits;
+						dst[byteCount + 1] = bits >> 8;
+						dst[byteCount + 2] = bits >> 16;
+						dst[byteCount + 3] = bits >> 24;
+						byteCount += 4;
+						bits >>= 32;
+						bitCount -= 32;
+					}
+				}
+
+				// Write the remaining bits and return the number of bits in dst, the last byte being padded with zeros
+				uint64_t finish()
+				{
+					const uint64_t bitCountTotal = (byteCount << 3) + bitCount;
+					for (; bitCount > 0; bitCount -= std::min<uint8_t>(bitCount, 8), ++byteCount)
+					{
+						dst[byteCount] = bits;
+						bits >>= 8;
+					}
+					return bitCountTotal;
+				}
+
+				uint8_t* dst;
+				uint64_t byteCount = 0;
+				uint64_t bits = 0;
+				uint8_t bitCount = 0;
+			};
+
+			struct DynamicHeader
+			{
+				uint16_t hlit;
+				uint8_t hdist;
+				uint8_t hclen;
+				uint64_t codeLengths[19];	// Code lengths of the code length alphabet
+				uint8_t runSymbols[320];
+				uint8_t runExtras[320];
+				uint16_t runCount;
+				uint64_t bitCount;			// Size of the header without BFINAL and BTYPE
+			};
+
+			void computeDynamicHeader(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths, DynamicHeader& header);
+
+			// Size of the symbols of a block with their extra bits, occurences and codeLengths holding the literal/length then distance alphabets
+			uint64_t getSymbolsBitCount(const uint64_t* occurences, const uint8_t* codeLengths)
+			{
+				uint64_t bitCount = 0;
+				for (uint16_t i = 0; i < 320; ++i)
+				{
+					bitCount += occurences[i] * codeLengths[i];
+				}
+				for (uint8_t i = 0; i < 29; ++i)
+				{
+					bitCount += occurences[257 + i] * lenExtraBits[i];
+				}
+				for (uint8_t i = 0; i < 30; ++i)
+				{
+					bitCount += occurences[288 + i] * distExtraBits[i];
+				}
+
+				return bitCount;
+			}
+
+			// Decoders such as zlib reject incomplete codes, so at least two symbols always get a code
+			void occurencesToCodeLengths(uint64_t* occurences, uint64_t* codeLengths, uint64_t symbolCount, uint8_t maxCodeLength, uint64_t* scratch)
+			{
+				uint8_t usedCount = 0;
+				for (uint64_t i = 0; i < symbolCount && usedCount < 2; ++i)
+				{
+					usedCount += occurences[i] != 0;
+				}
+				for (uint64_t i = 0; usedCount < 2; ++i)
+				{
+					if (occurences[i] == 0)
+					{
+						occurences[i] = 1;
+						++usedCount;
+					}
+				}
+
+				HuffmanEncoder<uint16_t, std::endian::little>::symbolOccurencesToCodeLengths(occurences, codeLengths, symbolCount, maxCodeLength, scratch);
+			}
+
+			void computeDynamicHeader(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths, DynamicHeader& header)
+			{
+				assert(litlenCodeLengths[256] != 0);
+
+				// Compute HLIT and HDIST, and put the code lengths of both alphabets in a single sequence
+
+				header.hlit = 288;
+				for (; header.hlit > 257 && litlenCodeLengths[header.hlit - 1] == 0; --header.hlit);
+
+				header.hdist = 32;
+				for (; header.hdist > 1 && distCodeLengths[header.hdist - 1] == 0; --header.hdist);
+
+				uint8_t codeLengths8bit[320];
+				std::copy_n(litlenCodeLengths, header.hlit, codeLengths8bit);
+				std::copy_n(distCodeLengths, header.hdist, codeLengths8bit + header.hlit);
+				const uint16_t codeLengthCount = header.hlit + header.hdist;
+
+				// Run-length encode the sequence: 16 repeats the previous length 3-6 times, 17 and 18 repeat 0 3-10 and 11-138 times
+
+				std::fill_n(header.runExtras, 320, 0);
+				header.runCount = 0;
+
+				for (uint16_t i = 0; i < codeLengthCount;)
+				{
+					const uint8_t codeLength = codeLengths8bit[i];
+					uint16_t repeat = 1;
+					for (; i + repeat < codeLengthCount && codeLengths8bit[i + repeat] == codeLength; ++repeat);
+					i += repeat;
+
+					if (codeLength == 0)
+					{
+						for (; repeat >= 11; ++header.runCount)
+						{
+							const uint8_t count = std::min<uint16_t>(repeat, 138);
+							header.runSymbols[header.runCount] = 18;
+							header.runExtras[header.runCount] = count - 11;
+							repeat -= count;
+						}
+						if (repeat >= 3)
+						{
+							header.runSymbols[header.runCount] = 17;
+							header.runExtras[header.runCount] = repeat - 3;
+							++header.runCount;
+							repeat = 0;
+						}
+					}
+					else
+					{
+						header.runSymbols[header.runCount] = codeLength;
+						++header.runCount;
+						--repeat;
+
+						for (; repeat >= 3; ++header.runCount)
+						{
+							const uint8_t count = std::min<uint16_t>(repeat, 6);
+							header.runSymbols[header.runCount] = 16;
+							header.runExtras[header.runCount] = count - 3;
+							repeat -= count;
+						}
+					}
+
+					for (; repeat; --repeat, ++header.runCount)
+					{
+						header.runSymbols[header.runCount] = codeLength;
+					}
+				}
+
+				// Compute the code of the code length alphabet, and HCLEN to skip the unused lengths at the end of its order
+
+				uint64_t occurences[19] = {};
+				for (uint16_t i = 0; i < header.runCount; ++i)
+				{
+					++occurences[header.runSymbols[i]];
+				}
+
+				uint64_t scratch[38];
+				occurencesToCodeLengths(occurences, header.codeLengths, 19, 7, scratch);
+
+				header.hclen = 19;
+				for (; header.hclen > 4 && header.codeLengths[codeLengthsOrder[header.hclen - 1]] == 0; --header.hclen);
+
+				header.bitCount = 5 + 5 + 4 + 3 * header.hclen;
+				for (uint8_t i = 0; i < 19; ++i)
+				{
+					header.bitCount += occurences[i] * header.codeLengths[i];
+				}
+				header.bitCount += occurences[16] * 2 + occurences[17] * 3 + occurences[18] * 7;
+			}
+
+			inline uint32_t hashBytes(const uint8_t* bytes, uint8_t hashBits)
+			{
+				const uint32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+				return (value * 0x9E3779B1u) >> (32 - hashBits);
+			}
+
+			// Extend a match of length bytes up to maxLength, comparing 8 bytes at a time
+			inline uint16_t extendMatch(const uint8_t* match, const uint8_t* current, uint16_t length, uint16_t maxLength)
+			{
+				// The first different byte is given by the lowest different bit
+
+				for (; length + 8 <= maxLength; length += 8)
+				{
+					uint64_t a, b;
+					std::memcpy(&a, match + length, 8);
+					std::memcpy(&b, current + length, 8);
+					if (a != b)
+					{
+						if constexpr (std::endian::native == std::endian::little)
+						{
+							return length + (std::countr_zero(a ^ b) >> 3);
+						}
+						else
+						{
+							return length + (std::countl_zero(a ^ b) >> 3);
+						}
+					}
+				}
+
+				for (; length < maxLength && match[length] == current[length]; ++length);
+
+				return length;
+			}
+
+			// Handles of the streams used by the one-shot functions
+
+			struct MemoryInput
+			{
+				const uint8_t* data;
+				uint64_t size;
+			};
+
+			uint64_t readMemory(void* handle, uint8_t* data, uint64_t size)
+			{
+				MemoryInput& input = *static_cast<MemoryInput*>(handle);
+				size = std::min(size, input.size);
+				std::copy_n(input.data, size, data);
+				input.data += size;
+				input.size -= size;
+				return size;
+			}
 
-				TSymbol* symbolsEnd = symbols + symbolCount;
-				uint8_t* codeLengthsEnd = codeLengths + symbolCount;
+			bool isMemoryEnded(void* handle)
+			{
+				return static_cast<MemoryInput*>(handle)->size == 0;
+			}
+
+			struct MemoryOutput
+			{
+				uint8_t* data;
+				uint64_t size;
+				uint64_t sizeWritten;
+			};
+
+			uint64_t writeMemory(void* handle, const uint8_t* data, uint64_t size)
+			{
+				MemoryOutput& output = *static_cast<MemoryOutput*>(handle);
+				size = std::min(size, output.size - output.sizeWritten);
+				std::copy_n(data, size, output.data + output.sizeWritten);
+				output.sizeWritten += size;
+				return size;
+			}
+
+			// Chunks decoded without the data preceding them see it as markers, the marker of a byte being 256 + its index
+
+			constexpr uint16_t markerWindowSize = 32768;
+			constexpr std::array<uint16_t, markerWindowSize> windowMarkers = []()
+			{
+				std::array<uint16_t, markerWindowSize> markers;
+				for (uint16_t i = 0; i < markerWindowSize; ++i)
+				{
+					markers[i] = 256 + i;
+				}
+
+				return markers;
+			}();
+
+			// Get the bits of src from bitPosition in the lowest bits, at least 57 of them unless src ends before, zeros past its end
+			uint64_t peekBits(std::span<const uint8_t> src, uint64_t bitPosition)
+			{
+				const uint64_t byteIndex = bitPosition >> 3;
+				if (byteIndex >= src.size())
+				{
+					return 0;
+				}
 
-				while (*codeLengthsEnd == 0)
+				uint64_t bits = 0;
+				if (src.size() - byteIndex >= 8)
+				{
+					std::memcpy(&bits, src.data() + byteIndex, 8);
+					if constexpr (std::endian::native == std::endian::big)
+					{
+						bits = std::byteswap(bits);
+					}
+				}
+				else
 				{
-					--codeLengthsEnd;
-					--symbolsEnd;
-					--symbolCount;
+					for (uint64_t i = byteIndex; i < src.size(); ++i)
+					{
+						bits |= static_cast<uint64_t>(src[i]) << ((i - byteIndex) << 3);
+					}
 				}
 
-				// Move the 0s that are not already at the end to the end
+				return bits >> (bitPosition & 7);
+			}
 
+			// Check that the code lengths fill the code space, a single code of 1 bit and no code at all being accepted as zlib does
+			bool isCompleteCode(const uint8_t* codeLengths, uint16_t symbolCount)
+			{
+				uint32_t space = 0;
+				uint16_t codeCount = 0;
 				for (uint16_t i = 0; i < symbolCount; ++i)
 				{
-					if (codeLengths[i] == 0)
+					if (codeLengths[i])
+					{
+						space += 1 << (15 - codeLengths[i]);
+						++codeCount;
+					}
+				}
+
+				return space == (1 << 15) || (codeCount == 1 && space == (1 << 14)) || codeCount == 0;
+			}
+
+			// Check the header of a non-final block with dynamic codes at bitPosition, without building any table
+			bool isDynamicBlockStart(std::span<const uint8_t> src, uint64_t bitPosition)
+			{
+				const uint64_t endBitPosition = src.size() << 3;
+				if (bitPosition + 17 > endBitPosition)
+				{
+					return false;
+				}
+
+				uint64_t bits = peekBits(src, bitPosition);
+				if ((bits & 7) != 0b100)
+				{
+					return false;
+				}
+
+				const uint16_t hlit = ((bits >> 3) & 31) + 257;
+				const uint16_t hdist = ((bits >> 8) & 31) + 1;
+				const uint8_t hclen = ((bits >> 13) & 15) + 4;
+				if (hlit > 286 || hdist > 30)
+				{
+					return false;
+				}
+
+				// The code of the code lengths must be complete, it is what rejects most positions
+
+				bitPosition += 17;
+				if (bitPosition + 3 * hclen > endBitPosition)
+				{
+					return false;
+				}
+
+				bits = peekBits(src, bitPosition);
+				bitPosition += 3 * hclen;
+
+				uint64_t codeLengths[19] = {};
+				uint32_t space = 0;
+				for (uint8_t i = 0; i < hclen; ++i)
+				{
+					codeLengths[codeLengthsOrder[i]] = (bits >> (3 * i)) & 7;
+					if (codeLengths[codeLengthsOrder[i]])
 					{
-						std::swap(codeLengths[i], *codeLengthsEnd);
-						std::swap(symbols[i], *symbolsEnd);
-						--codeLengthsEnd;
-						--symbolsEnd;
-						--symbolCount;
-						--i;
+						space += 1 << (7 - codeLengths[codeLengthsOrder[i]]);
 					}
 				}
 
-				// Now we only have non-0 codeLengths, bubble sort
+				if (space != (1 << 7))
+				{
+					return false;
+				}
+
+				uint64_t codes[19];
+				_dsk::huffmanCodeLengthsToCodes(codeLengths, codes, 19);
+
+				uint8_t tableSymbols[1 << 7];
+				uint8_t tableLengths[1 << 7];
+				for (uint8_t i = 0; i < 19; ++i)
+				{
+					if (codeLengths[i])
+					{
+						for (uint8_t j = _dsk::huffmanReverseCode(codes[i], codeLengths[i]); j < (1 << 7); j += (1 << codeLengths[i]))
+						{
+							tableSymbols[j] = i;
+							tableLengths[j] = codeLengths[i];
+						}
+					}
+				}
+
+				// Decode the code lengths of the two alphabets, which must give complete codes and an end of block
+
+				const uint16_t codeLengthCount = hlit + hdist;
+				uint8_t codeLengths8bit[286 + 30];
+				uint16_t i = 0;
+				while (i != codeLengthCount)
+				{
+					bits = peekBits(src, bitPosition);
+					const uint8_t symbol = tableSymbols[bits & 127];
+					bitPosition += tableLengths[bits & 127];
+					bits >>= tableLengths[bits & 127];
+
+					uint8_t value = 0;
+					uint8_t repeat = 1;
+					if (symbol < 16)
+					{
+						value = symbol;
+					}
+					else if (symbol == 16)
+					{
+						if (i == 0)
+						{
+							return false;
+						}
+
+						value = codeLengths8bit[i - 1];
+						repeat = (bits & 3) + 3;
+						bitPosition += 2;
+					}
+					else if (symbol == 17)
+					{
+						repeat = (bits & 7) + 3;
+						bitPosition += 3;
+					}
+					else
+					{
+						repeat = (bits & 127) + 11;
+						bitPosition += 7;
+					}
+
+					if (i + repeat > codeLengthCount || bitPosition > endBitPosition)
+					{
+						return false;
+					}
+
+					std::fill_n(codeLengths8bit + i, repeat, value);
+					i += repeat;
+				}
+
+				return codeLengths8bit[256] && isCompleteCode(codeLengths8bit, hlit) && isCompleteCode(codeLengths8bit + hlit, hdist);
+			}
+
+			// Write the bytes of data from begin to end, window holding the windowSize bytes preceding data
+			bool resolveMarkers(const uint16_t* data, uint64_t begin, uint64_t end, const uint8_t* window, uint64_t windowSize, uint8_t* dst)
+			{
+				// With a whole window, every value is translated through a table, without branches
+
+				if (windowSize >= markerWindowSize)
+				{
+					std::array<uint8_t, 256 + markerWindowSize> values;
+					for (uint16_t i = 0; i < 256; ++i)
+					{
+						values[i] = i;
+					}
+					std::copy_n(window + windowSize - markerWindowSize, markerWindowSize, values.begin() + 256);
+
+					for (uint64_t i = begin; i < end; ++i)
+					{
+						dst[i] = values[data[i]];
+					}
+
+					return true;
+				}
 
-				bool changed = true;
-				while (changed)
+				for (uint64_t i = begin; i < end; ++i)
 				{
-					changed = false;
-					for (uint16_t i = 1; i < symbolCount; ++i)
+					if (data[i] < 256)
+					{
+						dst[i] = data[i];
+					}
+					else
 					{
-						if (codeLengths[i] < codeLengths[i - 1])
+						const uint64_t distance = markerWindowSize - (data[i] - 256);
+						if (distance > windowSize)
 						{
-							std::swap(codeLengths[i], codeLengths[i - 1]);
-							std::swap(symbols[i], symbols[i - 1]);
-							changed = true;
+							return false;
 						}
+
+						dst[i] = window[windowSize - distance];
+					}
+				}
+
+				return true;
+			}
+
+			void runTasks(const deflate::TaskRunner& taskRunner, uint64_t taskCount, const std::function<void(uint64_t)>& task)
+			{
+				if (taskRunner)
+				{
+					taskRunner(taskCount, task);
+				}
+				else
+				{
+					for (uint64_t i = 0; i < taskCount; ++i)
+					{
+						task(i);
 					}
 				}
 			}
 		}
 
 		DeflateIStream::DeflateIStream(IStream* stream) : FormatIStream(stream),
-			_litlenDecoder(nullptr),
-			_distDecoder(nullptr),
+			_litlenTable(nullptr),
+			_distTable(nullptr),
+			_codeLengths(),
+			_dynamicLitlenTable(),
+			_dynamicDistTable(),
+			_codeLengthTable(),
 			_readingBlock(false),
 			_readingLastBlock(false),
 			_currentBlockCompressed(false),
 			_currentBlockRemainingSize(0),
 			_bytesRead(0),
-			_window(),
+			_windowSize(_maxWindowSize),
+			_window(2 * _windowSize + _maxMatchLength + 8, 0),
 			_windowIndex(0),
-			_repeaterDistance(0),
-			_remainingRepeats(0)
+			_outputIndex(0)
 		{
 			if (stream)
 			{
@@ -113,15 +646,17 @@ namespace dsk
 		
 			DSK_CALL(readBlockHeader, block.header);
 		
-			// Read block data
+			// Read block data, directly in block.data which grows geometrically so that it is decoded in place
 		
-			constexpr uint64_t bufferSize = _singleBufferSize;
-			uint8_t buffer[bufferSize];
+			uint64_t size = 0;
 			uint64_t sizeRead;
 			do {
-				DSK_CALL(readBlockData, buffer, bufferSize, sizeRead);
-				block.data.insert(block.data.end(), buffer, buffer + sizeRead);
-			} while (sizeRead == bufferSize);
+				block.data.resize(std::max<uint64_t>(2 * size, _minDirectOutputSize));
+				DSK_CALL(readBlockData, block.data.data() + size, block.data.size() - size, sizeRead);
+				size += sizeRead;
+			} while (size == block.data.size());
+
+			block.data.resize(size);
 		
 			// Read block end
 		
@@ -174,11 +709,8 @@ namespace dsk
 					_currentBlockCompressed = true;
 					_currentBlockLastByteRead = false;
 					
-					std::fill_n(header.litlenCodeLengths, 144, 8);
-					std::fill_n(header.litlenCodeLengths + 144, 256 - 144, 9);
-					std::fill_n(header.litlenCodeLengths + 256, 280 - 256, 7);
-					std::fill_n(header.litlenCodeLengths + 280, 288 - 280, 8);
-					std::fill_n(header.distCodeLengths, 32, 5);
+					std::copy_n(fixedCodeLengths.begin(), 288, header.litlenCodeLengths);
+					std::copy_n(fixedCodeLengths.begin() + 288, 32, header.distCodeLengths);
 
 					break;
 				}
@@ -196,40 +728,34 @@ namespace dsk
 					DSKFMT_STREAM_CALL(bitRead, &buffer, 4);
 					const uint8_t hclen = buffer + 4;
 		
-					// Read code lengths for the code length alphabet and create the associated huffman decoder
-		
-					uint8_t symbols[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+					// Read code lengths for the code length alphabet and create the associated decoding table
 		
+					std::fill_n(codeLengths, 19, 0);
 					for (uint8_t i = 0; i < hclen; ++i)
 					{
-						DSKFMT_STREAM_CALL(bitRead, codeLengths8bit + i, 3);
+						buffer = 0;
+						DSKFMT_STREAM_CALL(bitRead, &buffer, 3);
+						codeLengths[codeLengthsOrder[i]] = buffer;
 					}
-					std::fill_n(codeLengths8bit + hclen, 19 - hclen, 0);
 
-					uint16_t symbolCount = 19;
-					sortCodeLengths(symbols, codeLengths8bit, symbolCount);
-					std::copy_n(codeLengths8bit, symbolCount, codeLengths);
-
-					HuffmanDecoder<uint8_t, std::endian::little> codeLengthsDecoder(symbols, codeLengths, symbolCount);
+					DSK_CHECK(_buildDecodeTable(codeLengths, 19, false, _codeLengthRootBits, _codeLengthTable), "Code length code lengths are over-subscribed.");
 					
 					// Read code lengths for the two alphabets (literal/length + distances)
 
 					const uint16_t codeLengthCount = hlit + hdist;
-		
-					bool success;
 
-					uint64_t bytesRead;
 					uint8_t bitsRead;
 					uint8_t nextByte;
 					DSKFMT_STREAM_CALL(bitRead, &nextByte, 8, 0);
 
-					uint8_t symbol;
-
 					uint16_t i = 0;
 					while (i != codeLengthCount)
 					{
-						success = codeLengthsDecoder.readSymbol(symbol, &nextByte, bytesRead, bitsRead);
-						DSK_CHECK(success, "Error while reading code length symbol.");
+						const DecodeEntry& entry = _codeLengthTable[nextByte & ((1 << _codeLengthRootBits) - 1)];
+						DSK_CHECK(entry.type == DecodeType::Literal, "Error while reading code length symbol.");
+
+						const uint8_t symbol = entry.value;
+						bitsRead = entry.codeLength;
 
 						nextByte >>= bitsRead;
 						DSKFMT_STREAM_CALL(bitRead, &nextByte, bitsRead, 8 - bitsRead);
@@ -241,35 +767,34 @@ namespace dsk
 						}
 						else
 						{
+							uint8_t repeat;
+							uint8_t codeLength = 0;
 							if (symbol == 16)
 							{
 								DSK_CHECK(i != 0, "The first symbol cannot be a repeat symbol.");
 
 								bitsRead = 2;
-								const uint8_t repeat = (nextByte & 3) + 3;
-								std::fill_n(codeLengths8bit + i, repeat, codeLengths8bit[i - 1]);
-								i += repeat;
+								repeat = (nextByte & 3) + 3;
+								codeLength = codeLengths8bit[i - 1];
 							}
 							else if (symbol == 17)
 							{
 								bitsRead = 3;
-								const uint8_t repeat = (nextByte & 7) + 3;
-								std::fill_n(codeLengths8bit + i, repeat, 0);
-								i += repeat;
+								repeat = (nextByte & 7) + 3;
 							}
-							else if (symbol == 18)
+							else
 							{
 								bitsRead = 7;
-								const uint8_t repeat = (nextByte & 127) + 11;
-								std::fill_n(codeLengths8bit + i, repeat, 0);
-								i += repeat;
+								repeat = (nextByte & 127) + 11;
 							}
 
+							DSK_CHECK(i + repeat <= codeLengthCount, "Too many code lengths given for dynamic huffman tree.");
+							std::fill_n(codeLengths8bit + i, repeat, codeLength);
+							i += repeat;
+
 							nextByte >>= bitsRead;
 							DSKFMT_STREAM_CALL(bitRead, &nextByte, bitsRead, 8 - bitsRead);
 						}
-		
-						DSK_CHECK(i <= codeLengthCount, "Too many code lengths given for dynamic huffman tree.");
 					}
 
 					DSKFMT_STREAM_CALL(bitUnread, 8);
@@ -278,48 +803,32 @@ namespace dsk
 					std::fill_n(header.litlenCodeLengths + hlit, 288 - hlit, 0);
 					std::copy_n(codeLengths8bit + hlit, hdist, header.distCodeLengths);
 					std::fill_n(header.distCodeLengths + hdist, 32 - hdist, 0);
-		
-					// TODO: Check the code lengths are valid
 
 					break;
 				}
 			}
 
-			// Create huffman decoders if necessary
+			// Get the decoding tables, the dynamic ones being built in the storage of the stream
 
-			if (_currentBlockCompressed)
+			if (header.compressionType == deflate::CompressionType::FixedHuffman)
 			{
-				{
-					uint16_t symbolCount = 288;
-					std::copy_n(header.litlenCodeLengths, 288, codeLengths8bit);
-
-					uint16_t symbols[288];
-					for (uint16_t i = 0; i < 288; ++i)
-					{
-						symbols[i] = i;
-					}
-
-					sortCodeLengths(symbols, codeLengths8bit, symbolCount);
-					std::copy_n(codeLengths8bit, symbolCount, codeLengths);
-
-					_litlenDecoder = new HuffmanDecoder<uint16_t, std::endian::little>(symbols, codeLengths, symbolCount);
-				}
-
-				{
-					uint16_t symbolCount = 32;
-					std::copy_n(header.distCodeLengths, 32, codeLengths8bit);
+				const FixedTables& tables = _getFixedTables();
+				_litlenTable = tables.litlen.data();
+				_distTable = tables.dist.data();
+			}
+			else if (header.compressionType == deflate::CompressionType::DynamicHuffman)
+			{
+				std::copy_n(header.litlenCodeLengths, 288, _codeLengths);
+				std::copy_n(header.distCodeLengths, 32, _codeLengths + 288);
 
-					uint8_t symbols[32];
-					for (uint16_t i = 0; i < 32; ++i)
-					{
-						symbols[i] = i;
-					}
+				std::copy_n(header.litlenCodeLengths, 288, codeLengths);
+				DSK_CHECK(_buildDecodeTable(codeLengths, 288, false, _litlenRootBits, _dynamicLitlenTable), "Literal/length code lengths are over-subscribed.");
 
-					sortCodeLengths(symbols, codeLengths8bit, symbolCount);
-					std::copy_n(codeLengths8bit, symbolCount, codeLengths);
+				std::copy_n(header.distCodeLengths, 32, codeLengths);
+				DSK_CHECK(_buildDecodeTable(codeLengths, 32, true, _distRootBits, _dynamicDistTable), "Distance code lengths are over-subscribed.");
 
-					_distDecoder = new HuffmanDecoder<uint8_t, std::endian::little>(symbols, codeLengths, symbolCount);
-				}
+				_litlenTable = _dynamicLitlenTable.data();
+				_distTable = _dynamicDistTable.data();
 			}
 		}
 		
@@ -333,131 +842,47 @@ namespace dsk
 
 			if (_currentBlockCompressed)
 			{
-				bool success;
-
-				uint64_t bytesRead;
-				uint8_t bitsRead;
-				uint8_t buffer[2];
-				DSKFMT_STREAM_CALL(bitRead, buffer, 16, 0);
-
-				uint16_t litlenSymbol;
-				uint8_t distSymbol;
-
 				sizeRead = 0;
-				while (size && !_currentBlockLastByteRead)
+				while (size)
 				{
-					// If repeating characters, extract nothing from the stream and just read in _window
-
-					if (_remainingRepeats)
+					if (_outputIndex == _windowIndex)
 					{
-						uint16_t iSrc = (_windowIndex + _windowSize - _repeaterDistance) & _windowIndexFilter;
-
-						for (; size && _remainingRepeats; --_remainingRepeats, --size, ++data, ++sizeRead, ++_bytesRead)
+						if (_currentBlockLastByteRead)
 						{
-							_window[_windowIndex] = _window[iSrc];
-							*data = _window[_windowIndex];
-
-							_windowIndex = (_windowIndex + 1) & _windowIndexFilter;
-							iSrc = (iSrc + 1) & _windowIndexFilter;
+							break;
 						}
-					}
-
-					// Parse a new symbol
-
-					else
-					{
-						// Read a literal/length symbol
 
-						success = _litlenDecoder->readSymbol(litlenSymbol, buffer, bytesRead, bitsRead);
-						DSK_CHECK(success, "Error while reading literal/length symbol.");
+						// Large outputs are decoded in place, the references before data are read from _window which
+						// is only updated at the end. Decoding stops early enough for the last match to fit in data.
 
-						buffer[0] = (bytesRead ? 0 : (buffer[1] << (8 - bitsRead))) | (buffer[bytesRead] >> bitsRead);
-						buffer[1] >>= bitsRead;
-						DSKFMT_STREAM_CALL(bitRead, buffer + (bytesRead == 0 || bitsRead == 0), (bytesRead << 3) + bitsRead, (8 - bitsRead) & 7);
+						if (size >= _minDirectOutputSize)
+						{
+							uint64_t dataIndex = 0;
+							DSK_CALL(_decodeSymbols, data, dataIndex, size - _maxMatchLength - 8, _window.data(), _windowIndex);
+							_appendToWindow(data, dataIndex);
 
-						// Raw byte
+							data += dataIndex;
+							size -= dataIndex;
+							sizeRead += dataIndex;
 
-						if (litlenSymbol < 256)
-						{
-							*data = litlenSymbol;
-							_window[_windowIndex] = *data;
-
-							--size;
-							++data;
-							++sizeRead;
-							++_bytesRead;
-							_windowIndex = (_windowIndex + 1) & _windowIndexFilter;
+							continue;
 						}
 
-						// End of block
+						// Other outputs are decoded in _window then copied
 
-						else if (litlenSymbol == 256)
-						{
-							_currentBlockLastByteRead = true;
-						}
-
-						// Repeater
-
-						else
-						{
-							DSK_CHECK(litlenSymbol < 286, "Codes 286-287 are reserved.");
-
-							// Read repeating length
-
-							static constexpr uint8_t lenExtraBits[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
-							static constexpr uint8_t filterLenExtraBits[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 3, 3, 3, 3, 7, 7, 7, 7, 15, 15, 15, 15, 31, 31, 31, 31, 0 };
-							static constexpr uint16_t lenStart[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
-
-							litlenSymbol -= 257;
-							_remainingRepeats = lenStart[litlenSymbol];
-
-							bitsRead = lenExtraBits[litlenSymbol];
-							if (bitsRead)
-							{
-								_remainingRepeats += buffer[0] & filterLenExtraBits[litlenSymbol];
-								buffer[0] = (bytesRead ? 0 : (buffer[1] << (8 - bitsRead))) | (buffer[bytesRead] >> bitsRead);
-								buffer[1] >>= bitsRead;
-								DSKFMT_STREAM_CALL(bitRead, buffer + 1, bitsRead, 8 - bitsRead);
-							}
-
-							// Read repeating distance
-
-							static constexpr uint8_t distExtraBits[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
-							static constexpr uint16_t filterDistExtraBits[] = { 0, 0, 0, 0, 1, 1, 3, 3, 7, 7, 15, 15, 31, 31, 63, 63, 127, 127, 0, 0, 1, 1, 3, 3, 7, 7, 15, 15, 31, 31 };
-							static constexpr uint16_t distStart[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
-
-							success = _distDecoder->readSymbol(distSymbol, buffer, bytesRead, bitsRead);
-							DSK_CHECK(success, "Error while reading distance symbol.");
-							DSK_CHECK(distSymbol < 30, "Distance codes 30-31 are reserved.");
-
-							buffer[0] = (bytesRead ? 0 : (buffer[1] << (8 - bitsRead))) | (buffer[bytesRead] >> bitsRead);
-							buffer[1] >>= bitsRead;
-							DSKFMT_STREAM_CALL(bitRead, buffer + 1 - bytesRead, (bytesRead << 3) + bitsRead, (8 - bitsRead) & 7);
-
-							_repeaterDistance = distStart[distSymbol];
+						DSK_CALL(_decodeInWindow, size);
+					}
 
-							bytesRead = distExtraBits[distSymbol] >> 3;
-							bitsRead = distExtraBits[distSymbol] & 7;
-							if (bytesRead)
-							{
-								_repeaterDistance += buffer[0] | ((buffer[1] & filterDistExtraBits[distSymbol]) << 8);
-								buffer[0] = buffer[1] >> bitsRead;
-								DSKFMT_STREAM_CALL(bitRead, buffer + (bitsRead == 0), 8 + bitsRead, (8 - bitsRead) & 7);
-							}
-							else if (bitsRead)
-							{
-								_repeaterDistance += buffer[0] & filterDistExtraBits[distSymbol];
-								buffer[0] = (buffer[1] << (8 - bitsRead)) | (buffer[0] >> bitsRead);
-								buffer[1] >>= bitsRead;
-								DSKFMT_STREAM_CALL(bitRead, buffer + 1, bitsRead, 8 - bitsRead);
-							}
+					const uint64_t outputSize = std::min<uint64_t>(_windowIndex - _outputIndex, size);
+					std::copy_n(_window.data() + _outputIndex, outputSize, data);
 
-							DSK_CHECK(_repeaterDistance <= _bytesRead, "Distance code goes further than beginning of deflate stream window.");
-						}
-					}
+					_outputIndex += outputSize;
+					data += outputSize;
+					size -= outputSize;
+					sizeRead += outputSize;
 				}
 
-				DSKFMT_STREAM_CALL(bitUnread, 16);
+				_bytesRead += sizeRead;
 			}
 
 			// Uncompressed data
@@ -469,26 +894,7 @@ namespace dsk
 				_currentBlockRemainingSize -= sizeRead;
 				_bytesRead += sizeRead;
 
-				if (sizeRead < _windowSize)
-				{
-					if (_windowIndex + sizeRead > _windowSize)
-					{
-						uint16_t sizeBegin = _windowSize - _windowIndex;
-						std::copy_n(data, sizeBegin, _window + _windowIndex);
-						std::copy_n(data + sizeBegin, sizeRead - sizeBegin, _window);
-					}
-					else
-					{
-						std::copy_n(data, sizeRead, _window + _windowIndex);
-					}
-
-					_windowIndex = (_windowIndex + sizeRead) & _windowIndexFilter;
-				}
-				else
-				{
-					std::copy_n(data - _windowSize, _windowSize, _window);
-					_windowIndex = 0;
-				}
+				_appendToWindow(data, sizeRead);
 			}
 		}
 		
@@ -500,31 +906,17 @@ namespace dsk
 
 			if (_currentBlockCompressed)
 			{
+				// The end of block code is not read yet if the caller stopped exactly at the end of the data
+
 				if (!_currentBlockLastByteRead)
 				{
-					assert(_remainingRepeats == 0);
-					
-					uint64_t bytesRead;
-					uint8_t bitsRead;
-					uint8_t buffer[2];
-					DSKFMT_STREAM_CALL(bitRead, buffer, 16, 0);
-
-					uint16_t symbol;
-					_litlenDecoder->readSymbol(symbol, buffer, bytesRead, bitsRead);
-
-					DSKFMT_STREAM_CALL(bitUnread, 16 - (bytesRead << 3) - bitsRead);
+					DSK_CHECK(_outputIndex == _windowIndex, "Tried to end a block before reading all its data.");
+					DSK_CALL(_decodeInWindow, 1);
+					DSK_CHECK(_currentBlockLastByteRead && _outputIndex == _windowIndex, "Tried to end a block before reading all its data.");
 				}
 
-				delete _litlenDecoder;
-				_litlenDecoder = nullptr;
-
-				delete _distDecoder;
-				_distDecoder = nullptr;
-
 				_currentBlockCompressed = false;
 				_currentBlockRemainingSize = 0;	// More powerful than setting _currentBlockLastByteRead
-
-				_repeaterDistance = 0;
 			}
 			else
 			{
@@ -537,434 +929,2116 @@ namespace dsk
 				_readingLastBlock = false;
 				_bytesRead = 0;
 				_windowIndex = 0;
+				_outputIndex = 0;
 			}
 		}
 
-		DeflateIStream::~DeflateIStream()
+		void DeflateIStream::readIndex(deflate::Index& index, uint64_t interval, bool compressWindows)
 		{
-			if (_litlenDecoder)
-			{
-				delete _litlenDecoder;
-			}
+			DSKFMT_BEGIN();
 
-			if (_distDecoder)
-			{
-				delete _distDecoder;
-			}
-		}
-		
-		void DeflateIStream::setStreamState()
-		{
-			_stream->setBitEndianness(std::endian::little);
-			_stream->setByteEndianness(std::endian::little);
+			assert(!_readingBlock);
+			assert(!_bytesRead);
+
+			index.checkpoints.clear();
+
+			std::vector<uint8_t> buffer(_minDirectOutputSize);
+			deflate::BlockHeader header;
+			uint64_t nextPosition = interval;
+			do {
+				// Keep a checkpoint at the first block after each interval
+
+				if (_bytesRead >= nextPosition)
+				{
+					deflate::Checkpoint& checkpoint = index.checkpoints.emplace_back();
+					checkpoint.bitPosition = _stream->getBitPosition();
+					checkpoint.outputPosition = _bytesRead;
+					checkpoint.isWindowCompressed = compressWindows;
+
+					const uint32_t windowSize = std::min<uint32_t>(_windowIndex, _windowSize);
+					const std::span<const uint8_t> window(_window.data() + _windowIndex - windowSize, windowSize);
+					if (compressWindows)
+					{
+						ruc::Status status;
+						checkpoint.window.resize(deflate::deflateBound(windowSize));
+						checkpoint.window.resize(deflate::deflate(window, checkpoint.window, status, 1));
+						RUC_RELAYCOPY(status, _status, RUC_VOID);
+					}
+					else
+					{
+						checkpoint.window.assign(window.begin(), window.end());
+					}
+
+					nextPosition = _bytesRead + interval;
+				}
+
+				// Decode the block
+
+				uint64_t sizeRead;
+				DSK_CALL(readBlockHeader, header);
+				do {
+					DSK_CALL(readBlockData, buffer.data(), buffer.size(), sizeRead);
+				} while (sizeRead == buffer.size());
+				DSK_CALL(readBlockEnd);
+			} while (!header.isFinal);
 		}
 
-		void DeflateIStream::resetFormatState()
+		void DeflateIStream::seek(const deflate::Checkpoint& checkpoint)
 		{
-			if (_litlenDecoder)
+			DSKFMT_BEGIN();
+
+			assert(!_readingBlock);
+
+			if (checkpoint.isWindowCompressed)
 			{
-				delete _litlenDecoder;
-				_litlenDecoder = nullptr;
+				ruc::Status status;
+				_windowIndex = deflate::inflate(checkpoint.window, std::span(_window.data(), _windowSize), status);
+				RUC_RELAYCOPY(status, _status, RUC_VOID);
 			}
-
-			if (_distDecoder)
+			else
 			{
-				delete _distDecoder;
-				_distDecoder = nullptr;
+				DSK_CHECK(checkpoint.window.size() <= _windowSize, "Checkpoint window is larger than the deflate window.");
+				std::copy(checkpoint.window.begin(), checkpoint.window.end(), _window.begin());
+				_windowIndex = checkpoint.window.size();
 			}
 
-			_readingBlock = false;
-			_readingLastBlock = false;
-			_currentBlockCompressed = false;
-			_currentBlockRemainingSize = 0;
-			_bytesRead = 0;
-			_windowIndex = 0;
-			_repeaterDistance = 0;
-			_remainingRepeats = 0;
-		}
+			_outputIndex = _windowIndex;
+			_bytesRead = checkpoint.outputPosition;
 
+			DSK_CALL(_skipToBit, checkpoint.bitPosition);
+		}
 
-		DeflateOStream::DeflateOStream(OStream* stream) : FormatOStream(stream),
-			_litlenEncoder(nullptr),
-			_distEncoder(nullptr),
-			_writingBlock(false),
-			_writingLastBlock(false),
-			_currentBlockCompressed(false),
-			_currentBlockRemainingSize(0),
-			_bytesWritten(0),
-			_window(),
-			_windowIndex(0)
+		void DeflateIStream::saveState(deflate::IStreamState& state) const
 		{
-			if (stream)
+			state.bitPosition = _stream->getBitPosition();
+			state.outputPosition = _bytesRead;
+			state.readingBlock = _readingBlock;
+
+			// The header is rebuilt from the tables in use, the code lengths of dynamic blocks being kept for this
+
+			state.header.isFinal = _readingLastBlock;
+			state.remainingSize = 0;
+			state.endOfBlockRead = false;
+			if (!_readingBlock)
 			{
-				setStreamState();
+				state.header.compressionType = deflate::CompressionType::NoCompression;
 			}
-		}
-		
-		void DeflateOStream::writeFile(const deflate::File& file)
-		{
-			DSKFMT_BEGIN();
-		
-			assert(!_writingBlock);
-			assert(!_bytesWritten);
-		
-			assert(!file.blocks.empty());
-		
-			for (uint64_t i = 0; i < file.blocks.size() - 1; ++i)
+			else if (!_currentBlockCompressed)
 			{
-				assert(!file.blocks[i].header.isFinal);
+				state.header.compressionType = deflate::CompressionType::NoCompression;
+				state.remainingSize = _currentBlockRemainingSize;
 			}
-			assert(file.blocks.back().header.isFinal);
-		
-		
-			for (const deflate::Block& block : file.blocks)
+			else
 			{
-				DSK_CALL(writeBlock, block);
+				const bool isFixed = (_litlenTable == _getFixedTables().litlen.data());
+				const uint8_t* codeLengths = isFixed ? fixedCodeLengths.data() : _codeLengths;
+
+				state.header.compressionType = isFixed ? deflate::CompressionType::FixedHuffman : deflate::CompressionType::DynamicHuffman;
+				state.endOfBlockRead = _currentBlockLastByteRead;
+				std::copy_n(codeLengths, 288, state.header.litlenCodeLengths);
+				std::copy_n(codeLengths + 288, 32, state.header.distCodeLengths);
 			}
+
+			const uint32_t windowBegin = _outputIndex - std::min<uint32_t>(_outputIndex, _windowSize);
+			state.window.assign(_window.begin() + windowBegin, _window.begin() + _windowIndex);
+			state.pendingSize = _windowIndex - _outputIndex;
 		}
-		
-		void DeflateOStream::writeBlock(const deflate::Block& block)
-		{
-			DSKFMT_BEGIN();
-		
-			assert(!_writingBlock);
-		
-			DSK_CALL(writeBlockHeader, block.header, block.data.size());
-			DSK_CALL(writeBlockData, block.data.data(), block.data.size());
-			DSK_CALL(writeBlockEnd);
-		}
-		
-		void DeflateOStream::writeBlockHeader(const deflate::BlockHeader& header, uint16_t size)
+
+		void DeflateIStream::restoreState(const deflate::IStreamState& state)
 		{
 			DSKFMT_BEGIN();
-		
-			assert(!_writingBlock);
 
-			// Write the header flags (BFINAL and BTYPE)
+			assert(!_readingBlock);
+			assert(!_bytesRead);
 
-			_writingBlock = true;
-			_writingLastBlock = header.isFinal;
-		
-			DSKFMT_STREAM_CALL(bitWrite, header.isFinal);
-			DSKFMT_STREAM_CALL(bitWrite, reinterpret_cast<const uint8_t*>(&header.compressionType), 2);
-		
-			// Write the rest of the header depending on the compression type
+			DSK_CHECK(state.pendingSize <= state.window.size() && state.window.size() - state.pendingSize <= _windowSize, "State window is larger than the deflate window.");
+			DSK_CHECK(state.window.size() <= 2 * _windowSize + _maxMatchLength, "State window holds too many decoded bytes.");
 
-			uint16_t hlit = 288;
-			uint16_t hdist = 32;
-			uint64_t codeLengths[288];
-			uint8_t codeLengths8bit[320];
-			switch (header.compressionType)
+			std::copy(state.window.begin(), state.window.end(), _window.begin());
+			_windowIndex = state.window.size();
+			_outputIndex = _windowIndex - state.pendingSize;
+			_bytesRead = state.outputPosition;
+
+			// Restore the block being read, with its decoding tables
+
+			if (state.readingBlock)
 			{
-				case deflate::CompressionType::NoCompression:
-				{
-					_currentBlockCompressed = false;
-					_currentBlockRemainingSize = size;
-		
-					DSKFMT_STREAM_CALL(finishByte);
-					DSKFMT_STREAM_CALL(write, size);
-					DSKFMT_STREAM_CALL(write, static_cast<uint16_t>(~size));
+				_readingBlock = true;
+				_readingLastBlock = state.header.isFinal;
 
-					break;
-				}
-				case deflate::CompressionType::FixedHuffman:
+				switch (state.header.compressionType)
 				{
-					_currentBlockCompressed = true;
-
-					for (uint16_t i = 0; i < 144; ++i)
+					case deflate::CompressionType::NoCompression:
 					{
-						codeLengths8bit[i] = 8;
+						_currentBlockCompressed = false;
+						_currentBlockRemainingSize = state.remainingSize;
+
+						break;
 					}
-					for (uint16_t i = 144; i < 256; ++i)
+					case deflate::CompressionType::FixedHuffman:
 					{
-						codeLengths8bit[i] = 9;
+						_currentBlockCompressed = true;
+						_currentBlockLastByteRead = state.endOfBlockRead;
+
+						const FixedTables& tables = _getFixedTables();
+						_litlenTable = tables.litlen.data();
+						_distTable = tables.dist.data();
+
+						break;
 					}
-					for (uint16_t i = 256; i < 280; ++i)
+					case deflate::CompressionType::DynamicHuffman:
 					{
-						codeLengths8bit[i] = 7;
+						_currentBlockCompressed = true;
+						_currentBlockLastByteRead = state.endOfBlockRead;
+
+						std::copy_n(state.header.litlenCodeLengths, 288, _codeLengths);
+						std::copy_n(state.header.distCodeLengths, 32, _codeLengths + 288);
+
+						uint64_t codeLengths[288];
+						std::copy_n(state.header.litlenCodeLengths, 288, codeLengths);
+						DSK_CHECK(_buildDecodeTable(codeLengths, 288, false, _litlenRootBits, _dynamicLitlenTable), "Literal/length code lengths are over-subscribed.");
+
+						std::copy_n(state.header.distCodeLengths, 32, codeLengths);
+						DSK_CHECK(_buildDecodeTable(codeLengths, 32, true, _distRootBits, _dynamicDistTable), "Distance code lengths are over-subscribed.");
+
+						_litlenTable = _dynamicLitlenTable.data();
+						_distTable = _dynamicDistTable.data();
+
+						break;
 					}
-					for (uint16_t i = 280; i < 288; ++i)
+					default:
 					{
-						codeLengths8bit[i] = 8;
+						DSK_CHECK(false, "Compression type cannot be 0b11.");
 					}
-		
-					std::fill_n(codeLengths8bit + 288, 32, 5);
-		
-					break;
 				}
-				case deflate::CompressionType::DynamicHuffman:
-				{
-					_currentBlockCompressed = true;
-		
-					for (const uint8_t& x : header.litlenCodeLengths)
-					{
-						assert(x < 16);
-					}
-					for (const uint8_t& x : header.distCodeLengths)
-					{
-						assert(x < 16);
-					}
-					assert(header.litlenCodeLengths[256] != 0);
-		
-					uint8_t buffer;
-
-					// Compute and write HLIT
-		
-					for (; header.litlenCodeLengths[hlit - 1] == 0; --hlit);
-		
-					buffer = hlit - 257;
-					DSKFMT_STREAM_CALL(bitWrite, &buffer, 5);
-		
-					// Compute and write HDIST
-		
-					for (; header.distCodeLengths[hdist - 1] == 0 && hdist; --hdist);
-		
-					buffer = hdist - 1;
-					DSKFMT_STREAM_CALL(bitWrite, &buffer, 5);
-		
-					// Compute and write HCLEN
-		
-					// TODO: Compress code lengths
-		
-					uint8_t hclen = 19;
-		
-					buffer = hclen - 4;
-					DSKFMT_STREAM_CALL(bitWrite, &buffer, 4);
-		
-					// Write code lengths for the code length alphabet and create the associated huffman encoder
+			}
 
-					uint8_t symbols[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			DSK_CALL(_skipToBit, state.bitPosition);
+		}
 
-					std::fill_n(codeLengths8bit, hclen, 5);
+		void DeflateIStream::setDictionary(const uint8_t* data, uint64_t size)
+		{
+			assert(!_readingBlock);
+			assert(!_bytesRead);
 
-					for (uint8_t i = 0; i < hclen; ++i)
-					{
-						DSKFMT_STREAM_CALL(bitWrite, codeLengths8bit + i, 3);
-					}
-		
-					uint16_t symbolCount = hclen;
-					sortCodeLengths(symbols, codeLengths8bit, symbolCount);
-					std::copy_n(codeLengths8bit, symbolCount, codeLengths);
+			// Only the bytes in reach of the distances are kept
 
-					HuffmanEncoder<uint8_t, std::endian::little> codeLengthsEncoder(symbols, codeLengths, symbolCount);
+			const uint64_t dictionarySize = std::min<uint64_t>(size, _windowSize);
 
-					// Write code lengths for the literal/length alphabet to codeLengths8bit (used as a buffer to improve perfs)
+			std::copy_n(data + size - dictionarySize, dictionarySize, _window.data());
+			_windowIndex = dictionarySize;
+			_outputIndex = dictionarySize;
+		}
 
-					uint8_t bitCount = 0;
-					uint64_t byteCount = 0;
+		void DeflateIStream::setWindowSize(uint32_t windowSize)
+		{
+			assert(!_readingBlock);
+			assert(!_bytesRead);
+			assert(std::has_single_bit(windowSize) && windowSize >= 256 && windowSize <= _maxWindowSize);
 
-					for (uint16_t i = 0; i < hlit; ++i)
-					{
-						uint8_t bitsWritten;
-						uint64_t bytesWritten;
-						codeLengthsEncoder.writeSymbol(header.litlenCodeLengths[i], codeLengths8bit + byteCount, bitCount, bytesWritten, bitsWritten);
-						bitCount += bitsWritten;
-						byteCount += bytesWritten + (bitCount >> 3);
-						bitCount &= 7;
-					}
-		
-					// Write code lengths for the distance alphabet to codeLengths8bit (used as a buffer to improve perfs)
-		
-					for (uint8_t i = 0; i < hdist; ++i)
-					{
-						uint8_t bitsWritten;
-						uint64_t bytesWritten;
-						codeLengthsEncoder.writeSymbol(header.distCodeLengths[i], codeLengths8bit + byteCount, bitCount, bytesWritten, bitsWritten);
-						bitCount += bitsWritten;
-						byteCount += bytesWritten + (bitCount >> 3);
-						bitCount &= 7;
-					}
+			// The memory of a larger window is given back
 
-					// Write all code lengths to the stream
+			_windowSize = windowSize;
+			_window.resize(2 * _windowSize + _maxMatchLength + 8);
+			_window.shrink_to_fit();
+			_windowIndex = 0;
+			_outputIndex = 0;
+		}
 
-					DSKFMT_STREAM_CALL(bitWrite, codeLengths8bit, (byteCount << 3) + bitCount);
-		
-					// Fill codeLengths8bit to create encoder later
+		void DeflateIStream::readChunk(deflate::Chunk& chunk, uint64_t endBitPosition)
+		{
+			DSKFMT_BEGIN();
 
-					std::copy_n(header.litlenCodeLengths, 288, codeLengths8bit);
-					std::copy_n(header.distCodeLengths, 32, codeLengths8bit + 288);
+			assert(!_readingBlock);
 
-					break;
-				}
+			const uint8_t bitOffset = chunk.beginBitPosition & 7;
+			if (bitOffset)
+			{
+				uint8_t bits;
+				DSKFMT_STREAM_CALL(bitRead, &bits, bitOffset);
 			}
-		
-			// Create huffman encoders if necessary
 
-			if (_currentBlockCompressed)
-			{
-				{
-					uint16_t symbolCount = 288;
+			// The positions in the input are counted from the byte holding the beginning of the chunk
 
-					uint16_t symbols[288];
-					for (uint16_t i = 0; i < 288; ++i)
-					{
-						symbols[i] = i;
-					}
+			const uint64_t firstBitPosition = chunk.beginBitPosition - bitOffset;
 
-					sortCodeLengths(symbols, codeLengths8bit, symbolCount);
-					std::copy_n(codeLengths8bit, symbolCount, codeLengths);
+			chunk.data.clear();
 
-					_litlenEncoder = new HuffmanEncoder<uint16_t, std::endian::little>(symbols, codeLengths, symbolCount);
+			// The data is grown geometrically, leaving room for a stored block or for a large enough decoding step
+
+			uint64_t size = 0;
+			const auto reserveData = [&]()
+			{
+				if (chunk.data.size() < size + _minDirectOutputSize + _maxMatchLength + 8)
+				{
+					chunk.data.resize(std::max<uint64_t>(2 * chunk.data.size(), size + _minDirectOutputSize + _maxMatchLength + 8));
 				}
+			};
+
+			deflate::BlockHeader header;
+			do {
+				DSK_CALL(readBlockHeader, header);
 
+				if (_currentBlockCompressed)
 				{
-					uint16_t symbolCount = 32;
+					// Matches reaching before the chunk copy the markers of the bytes they reference
 
-					uint8_t symbols[32];
-					for (uint16_t i = 0; i < 32; ++i)
+					while (!_currentBlockLastByteRead)
 					{
-						symbols[i] = i;
+						reserveData();
+						DSK_CALL(_decodeSymbols<uint16_t>, chunk.data.data(), size, chunk.data.size() - _maxMatchLength - 8, windowMarkers.data(), markerWindowSize);
 					}
-
-					sortCodeLengths(symbols, codeLengths8bit + 288, symbolCount);
-					std::copy_n(codeLengths8bit + 288, symbolCount, codeLengths);
-
-					_distEncoder = new HuffmanEncoder<uint8_t, std::endian::little>(symbols, codeLengths, symbolCount);
 				}
-			}
-		}
-		
-		void DeflateOStream::writeBlockData(const uint8_t* data, uint64_t size)
-		{
-			DSKFMT_BEGIN();
-		
-			assert(_writingBlock);
-		
-			if (_currentBlockCompressed)
-			{
-				// TODO: LZ77 compression
-
-				uint8_t buffer[_singleBufferSize];
-				while (size)
+				else
 				{
-					uint8_t bitCount = 0;
-					uint64_t byteCount = 0;
-					uint64_t symbolCount = _singleBufferSize / 2;
-					for (; symbolCount && size; --symbolCount, --size, ++data, ++_bytesWritten)
-					{
-						_window[_windowIndex] = *data;
+					// The stored data is read by pieces then widened, _window being possibly smaller than a stored block
 
-						uint8_t bitsWritten;
-						uint64_t bytesWritten;
-						_litlenEncoder->writeSymbol(*data, buffer + byteCount, bitCount, bytesWritten, bitsWritten);
-						bitCount += bitsWritten;
-						byteCount += bytesWritten + (bitCount >> 3);
-						bitCount &= 7;
+					reserveData();
 
-						_windowIndex = (_windowIndex + 1) & _windowIndexFilter;
+					uint8_t buffer[_singleBufferSize];
+					while (_currentBlockRemainingSize)
+					{
+						const uint16_t pieceSize = std::min<uint64_t>(_currentBlockRemainingSize, _singleBufferSize);
+						DSKFMT_STREAM_CALL(read, buffer, pieceSize);
+						std::copy_n(buffer, pieceSize, chunk.data.data() + size);
+						size += pieceSize;
+						_currentBlockRemainingSize -= pieceSize;
 					}
-
-					DSKFMT_STREAM_CALL(bitWrite, buffer, (byteCount << 3) + bitCount);
 				}
-			}
-			else
-			{
-				assert(_currentBlockRemainingSize >= size);
-		
-				DSKFMT_STREAM_CALL(write, data, size);
-				_currentBlockRemainingSize -= size;
 
-				if (size < _windowSize)
+				DSK_CALL(readBlockEnd);
+			} while (!header.isFinal && firstBitPosition + _stream->getBitPosition() < endBitPosition);
+
+			chunk.data.resize(size);
+			chunk.endBitPosition = firstBitPosition + _stream->getBitPosition();
+			chunk.isLast = header.isFinal;
+		}
+
+		void DeflateIStream::setStreamState()
+		{
+			_stream->setBitEndianness(std::endian::little);
+			_stream->setByteEndianness(std::endian::little);
+		}
+
+		void DeflateIStream::resetFormatState()
+		{
+			_readingBlock = false;
+			_readingLastBlock = false;
+			_currentBlockCompressed = false;
+			_currentBlockRemainingSize = 0;
+			_bytesRead = 0;
+			_windowIndex = 0;
+			_outputIndex = 0;
+		}
+
+		bool DeflateIStream::_buildDecodeTable(const uint64_t* codeLengths, uint16_t symbolCount, bool isDistance, uint8_t rootBits, std::vector<DecodeEntry>& table)
+		{
+			assert(symbolCount <= 288);
+
+			uint64_t codes[288];
+			if (!_dsk::huffmanCodeLengthsToCodes(codeLengths, codes, symbolCount))
+			{
+				return false;
+			}
+
+			// Bits of the subtable of each root entry, given by the longest code starting with the root bits of the entry
+
+			const uint32_t rootSize = 1 << rootBits;
+			const uint32_t rootFilter = rootSize - 1;
+
+			uint8_t subtableBits[1 << _litlenRootBits] = {};
+			for (uint16_t i = 0; i < symbolCount; ++i)
+			{
+				codes[i] = _dsk::huffmanReverseCode(codes[i], codeLengths[i]);
+				if (codeLengths[i] > rootBits)
+				{
+					uint8_t& bits = subtableBits[codes[i] & rootFilter];
+					bits = std::max<uint8_t>(bits, codeLengths[i] - rootBits);
+				}
+			}
+
+			// Link the root entries to their subtables, packed after the root table
+
+			table.assign(rootSize, { 0, DecodeType::Invalid, 0, 0 });
+			for (uint32_t i = 0; i < rootSize; ++i)
+			{
+				if (subtableBits[i])
+				{
+					table[i] = { static_cast<uint16_t>(table.size()), DecodeType::Subtable, rootBits, subtableBits[i] };
+					table.resize(table.size() + (1 << subtableBits[i]), { 0, DecodeType::Invalid, 0, 0 });
+				}
+			}
+
+			// Fill the entries of each symbol, for all the values of the bits following its code
+
+			for (uint16_t i = 0; i < symbolCount; ++i)
+			{
+				const uint8_t codeLength = codeLengths[i];
+				if (codeLength == 0)
+				{
+					continue;
+				}
+
+				DecodeEntry entry = { 0, DecodeType::Invalid, codeLength, 0 };
+				if (isDistance)
 				{
-					if (_windowIndex + size > _windowSize)
+					if (i < 30)
 					{
-						uint16_t sizeBegin = _windowSize - _windowIndex;
-						std::copy_n(data, sizeBegin, _window + _windowIndex);
-						std::copy_n(data + sizeBegin, size - sizeBegin, _window);
+						entry = { distStart[i], DecodeType::Base, codeLength, distExtraBits[i] };
 					}
-					else
+				}
+				else if (i < 256)
+				{
+					entry = { i, DecodeType::Literal, codeLength, 0 };
+				}
+				else if (i == 256)
+				{
+					entry = { 0, DecodeType::EndOfBlock, codeLength, 0 };
+				}
+				else if (i < 286)
+				{
+					entry = { lenStart[i - 257], DecodeType::Base, codeLength, lenExtraBits[i - 257] };
+				}
+
+				if (codeLength <= rootBits)
+				{
+					for (uint32_t j = codes[i]; j < rootSize; j += (1 << codeLength))
 					{
-						std::copy_n(data, size, _window + _windowIndex);
+						table[j] = entry;
 					}
-
-					_windowIndex = (_windowIndex + size) & _windowIndexFilter;
 				}
 				else
 				{
-					std::copy_n(data - _windowSize, _windowSize, _window);
-					_windowIndex = 0;
+					const DecodeEntry& link = table[codes[i] & rootFilter];
+					const uint32_t subtableSize = 1 << link.extraBits;
+					for (uint32_t j = codes[i] >> rootBits; j < subtableSize; j += (1 << (codeLength - rootBits)))
+					{
+						table[link.value + j] = entry;
+					}
 				}
 			}
+
+			return true;
 		}
-		
-		void DeflateOStream::writeBlockEnd()
+
+		const DeflateIStream::FixedTables& DeflateIStream::_getFixedTables()
 		{
-			DSKFMT_BEGIN();
-		
-			assert(_writingBlock);
-		
-			if (_currentBlockCompressed)
+			// Built once for all the streams, on the first block with fixed codes
+
+			static const FixedTables tables = []()
 			{
-				uint8_t buffer[2];
-				uint64_t bytesWritten;
-				uint8_t bitsWritten;
-				_litlenEncoder->writeSymbol(256, buffer, bytesWritten, bitsWritten);
-				DSKFMT_STREAM_CALL(bitWrite, buffer, (bytesWritten << 3) + bitsWritten);
+				FixedTables tables;
+				uint64_t codeLengths[288];
 
-				delete _litlenEncoder;
-				_litlenEncoder = nullptr;
+				std::copy_n(fixedCodeLengths.begin(), 288, codeLengths);
+				_buildDecodeTable(codeLengths, 288, false, _litlenRootBits, tables.litlen);
 
-				delete _distEncoder;
-				_distEncoder = nullptr;
+				std::copy_n(fixedCodeLengths.begin() + 288, 32, codeLengths);
+				_buildDecodeTable(codeLengths, 32, true, _distRootBits, tables.dist);
 
-				_currentBlockCompressed = false;
-				_currentBlockRemainingSize = 0;
-			}
-			else
+				return tables;
+			}();
+
+			return tables;
+		}
+
+		void DeflateIStream::_decodeInWindow(uint64_t size)
+		{
+			assert(_outputIndex == _windowIndex);
+			assert(_window.size() >= 2 * _windowSize + _maxMatchLength + 8);
+
+			if (_windowIndex >= 2 * _windowSize)
 			{
-				assert(_currentBlockRemainingSize == 0);
+				_slideWindow();
 			}
 
-			_writingBlock = false;
-			if (_writingLastBlock)
+			// A match can end after endIndex, its last bytes are given on the next read
+
+			uint64_t windowIndex = _windowIndex;
+			DSK_CALL(_decodeSymbols<uint8_t>, _window.data(), windowIndex, std::min<uint64_t>(_windowIndex + size, 2 * _windowSize), nullptr, 0);
+			_windowIndex = windowIndex;
+		}
+
+		template<typename TOutput>
+		void DeflateIStream::_decodeSymbols(TOutput* dst, uint64_t& dstIndex, uint64_t endIndex, const TOutput* history, uint32_t historySize)
+		{
+			constexpr uint8_t valuesPerWord = 8 / sizeof(TOutput);
+			const DecodeEntry* const litlenTable = _litlenTable;
+			const DecodeEntry* const distTable = _distTable;
+			constexpr uint32_t litlenRootFilter = (1 << _litlenRootBits) - 1;
+			constexpr uint32_t distRootFilter = (1 << _distRootBits) - 1;
+
+			uint64_t index = dstIndex;
+
+			while (index < endIndex && !_currentBlockLastByteRead)
 			{
-				_writingLastBlock = false;
-				_bytesWritten = 0;
-				_windowIndex = 0;
+				// Decode from the buffer of the stream, the symbols are read through a 64-bit bit buffer
 
-				DSKFMT_STREAM_CALL(finishByte);
+				const uint8_t* src;
+				uint64_t srcSize;
+				uint8_t srcOffset;
+				DSKFMT_STREAM_CALL(bitPeek, src, srcSize, srcOffset, _minPeekSize);
+				const bool srcEnded = (srcSize < _minPeekSize);
+
+				uint64_t srcIndex = 0;
+				uint64_t bitBuffer = 0;
+				uint8_t bitCount = 0;
+
+				// Load whole words while possible, the bits above bitCount are then the next bits of src
+				const auto refill = [&]()
+				{
+					if (srcSize - srcIndex >= 8)
+					{
+						uint64_t word;
+						std::memcpy(&word, src + srcIndex, 8);
+						if constexpr (std::endian::native == std::endian::big)
+						{
+							word = std::byteswap(word);
+						}
+
+						bitBuffer |= word << bitCount;
+						srcIndex += (63 - bitCount) >> 3;
+						bitCount |= 56;
+					}
+					else
+					{
+						for (; bitCount <= 56 && srcIndex != srcSize; ++srcIndex, bitCount += 8)
+						{
+							bitBuffer |= static_cast<uint64_t>(src[srcIndex]) << bitCount;
+						}
+					}
+				};
+
+				refill();
+				bitBuffer >>= srcOffset;
+				bitCount -= srcOffset;
+
+				while (index < endIndex)
+				{
+					// Near the end of src, get more data from the stream unless it ended
+
+					refill();
+					if (bitCount < _maxSymbolBitCount && !srcEnded)
+					{
+						break;
+					}
+
+					// Read a literal/length symbol
+
+					const DecodeEntry* entry = litlenTable + (bitBuffer & litlenRootFilter);
+					if (entry->type == DecodeType::Subtable)
+					{
+						entry = litlenTable + entry->value + ((bitBuffer >> _litlenRootBits) & ((1 << entry->extraBits) - 1));
+					}
+
+					DSK_CHECK(entry->codeLength <= bitCount, "Unexpected end of deflate stream.");
+					bitBuffer >>= entry->codeLength;
+					bitCount -= entry->codeLength;
+
+					// Raw byte
+
+					if (entry->type == DecodeType::Literal)
+					{
+						dst[index] = entry->value;
+						++index;
+						continue;
+					}
+
+					// End of block
+
+					if (entry->type == DecodeType::EndOfBlock)
+					{
+						_currentBlockLastByteRead = true;
+						break;
+					}
+
+					// Repeater
+
+					DSK_CHECK(entry->type == DecodeType::Base, "Invalid literal/length code.");
+					DSK_CHECK(entry->extraBits <= bitCount, "Unexpected end of deflate stream.");
+
+					const uint16_t length = entry->value + (bitBuffer & ((1 << entry->extraBits) - 1));
+					bitBuffer >>= entry->extraBits;
+					bitCount -= entry->extraBits;
+
+					entry = distTable + (bitBuffer & distRootFilter);
+					if (entry->type == DecodeType::Subtable)
+					{
+						entry = distTable + entry->value + ((bitBuffer >> _distRootBits) & ((1 << entry->extraBits) - 1));
+					}
+
+					DSK_CHECK(entry->type == DecodeType::Base, "Invalid distance code.");
+					DSK_CHECK(entry->codeLength + entry->extraBits <= bitCount, "Unexpected end of deflate stream.");
+
+					bitBuffer >>= entry->codeLength;
+					const uint16_t distance = entry->value + (bitBuffer & ((1 << entry->extraBits) - 1));
+					bitBuffer >>= entry->extraBits;
+					bitCount -= entry->codeLength + entry->extraBits;
+
+					DSK_CHECK(distance <= index + historySize, "Distance code goes further than beginning of deflate stream window.");
+
+					// Copy 8 values at a time, which can write up to 7 values after the match. Overlapping matches are
+					// copied this way only if the distance is large enough for the values to be already written.
+
+					TOutput* out = dst + index;
+					const TOutput* const outEnd = out + length;
+					if (distance > index)
+					{
+						// The match starts in the history given apart from dst
+
+						int64_t position = static_cast<int64_t>(index) - distance;
+						for (; out != outEnd; ++out, ++position)
+						{
+							*out = (position < 0 ? history[historySize + position] : dst[position]);
+						}
+					}
+					else if (distance >= 8)
+					{
+						const TOutput* match = out - distance;
+						do {
+							std::memcpy(out, match, 8 * sizeof(TOutput));
+							out += 8;
+							match += 8;
+						} while (out < outEnd);
+					}
+					else if (distance == 1)
+					{
+						const uint64_t word = out[-1] * (std::numeric_limits<uint64_t>::max() / std::numeric_limits<TOutput>::max());
+						do {
+							for (uint8_t i = 0; i < sizeof(TOutput); ++i)
+							{
+								std::memcpy(out + i * valuesPerWord, &word, 8);
+							}
+
+							out += 8;
+						} while (out < outEnd);
+					}
+					else
+					{
+						const TOutput* match = out - distance;
+						do {
+							*out = *match;
+							++out;
+							++match;
+						} while (out < outEnd);
+					}
+
+					index += length;
+				}
+
+				// The bits left in bitBuffer are not consumed
+
+				DSKFMT_STREAM_CALL(bitSkip, (srcIndex << 3) - srcOffset - bitCount);
 			}
+
+			dstIndex = index;
 		}
-		
-		DeflateOStream::~DeflateOStream()
+
+		void DeflateIStream::_skipToBit(uint64_t bitPosition)
 		{
-			if (_litlenEncoder)
+			// The input stream is positioned on the byte holding bitPosition
+
+			const uint8_t bitOffset = bitPosition & 7;
+			if (bitOffset)
 			{
-				delete _litlenEncoder;
+				uint8_t bits;
+				DSKFMT_STREAM_CALL(bitRead, &bits, bitOffset);
 			}
+		}
+
+		void DeflateIStream::_slideWindow()
+		{
+			assert(_outputIndex == _windowIndex);
+			assert(_windowIndex >= _windowSize);
+
+			const uint32_t shift = _windowIndex - _windowSize;
+			std::copy(_window.begin() + shift, _window.begin() + _windowIndex, _window.begin());
+			_windowIndex -= shift;
+			_outputIndex -= shift;
+		}
+
+		void DeflateIStream::_appendToWindow(const uint8_t* data, uint64_t size)
+		{
+			assert(_outputIndex == _windowIndex);
+
+			// Only the last window size bytes can be referenced
 
-			if (_distEncoder)
+			if (size >= _windowSize)
 			{
-				delete _distEncoder;
+				std::copy_n(data + size - _windowSize, _windowSize, _window.data());
+				_windowIndex = _windowSize;
+			}
+			else
+			{
+				if (_windowIndex + size > 2 * _windowSize)
+				{
+					_slideWindow();
+				}
+
+				std::copy_n(data, size, _window.data() + _windowIndex);
+				_windowIndex += size;
 			}
+
+			_outputIndex = _windowIndex;
 		}
 
-		void DeflateOStream::setStreamState()
+
+		DeflateOStream::DeflateOStream(OStream* stream) : FormatOStream(stream),
+			_codes(nullptr),
+			_dynamicCodes(),
+			_writingBlock(false),
+			_writingLastBlock(false),
+			_currentBlockCompressed(false),
+			_automaticCodes(false),
+			_currentBlockRemainingSize(0),
+			_level(6),
+			_strategy(deflate::Strategy::Default),
+			_bytesWritten(0),
+			_window(2 * _windowSize + 8, 0),
+			_windowIndex(0),
+			_lookahead(0),
+			_hashIndex(0),
+			_hashHeads(_hashSize, 0),
+			_hashChains(_windowSize, 0),
+			_symbols(),
+			_matches(),
+			_matchOffsets(),
+			_pathNodes(),
+			_path(),
+			_blockSize(0),
+			_blockBytesAvailable(true),
+			_blockFixedBitCount(0),
+			_observations(),
+			_newObservations(),
+			_observationCount(0),
+			_newObservationCount(0)
 		{
-			_stream->setBitEndianness(std::endian::little);
-			_stream->setByteEndianness(std::endian::little);
-		}
+			_symbols.reserve(_maxSymbolCount);
 
-		void DeflateOStream::resetFormatState()
+			if (stream)
+			{
+				setStreamState();
+			}
+		}
+		
+		void DeflateOStream::writeFile(const deflate::File& file)
 		{
-			if (_litlenEncoder)
+			DSKFMT_BEGIN();
+		
+			assert(!_writingBlock);
+			assert(!_bytesWritten);
+		
+			assert(!file.blocks.empty());
+		
+			for (uint64_t i = 0; i < file.blocks.size() - 1; ++i)
+			{
+				assert(!file.blocks[i].header.isFinal);
+			}
+			assert(file.blocks.back().header.isFinal);
+		
+		
+			for (const deflate::Block& block : file.blocks)
 			{
-				delete _litlenEncoder;
-				_litlenEncoder = nullptr;
+				DSK_CALL(writeBlock, block);
 			}
+		}
+		
+		void DeflateOStream::writeBlock(const deflate::Block& block)
+		{
+			DSKFMT_BEGIN();
+		
+			assert(!_writingBlock);
+		
+			DSK_CALL(writeBlockHeader, block.header, block.data.size());
+			DSK_CALL(writeBlockData, block.data.data(), block.data.size());
+			DSK_CALL(writeBlockEnd);
+		}
+		
+		void DeflateOStream::writeBlockHeader(const deflate::BlockHeader& header, uint16_t size)
+		{
+			DSKFMT_BEGIN();
+		
+			assert(!_writingBlock);
+
+			_writingBlock = true;
+			_writingLastBlock = header.isFinal;
 
-			if (_distEncoder)
+			// Dynamic blocks without code lengths get them computed from their symbols, so their header is written at the end
+
+			_automaticCodes = header.compressionType == deflate::CompressionType::DynamicHuffman
+				&& std::all_of(header.litlenCodeLengths, header.litlenCodeLengths + 288, [](uint8_t x) { return x == 0; })
+				&& std::all_of(header.distCodeLengths, header.distCodeLengths + 32, [](uint8_t x) { return x == 0; });
+
+			if (_automaticCodes)
 			{
-				delete _distEncoder;
-				_distEncoder = nullptr;
+				_currentBlockCompressed = true;
+				_startAutomaticBlock();
+				return;
 			}
 
-			_writingBlock = false;
-			_writingLastBlock = false;
-			_currentBlockCompressed = false;
-			_currentBlockRemainingSize = 0;
-			_bytesWritten = 0;
-			_windowIndex = 0;
+			// Write the header flags (BFINAL and BTYPE)
+		
+			DSKFMT_STREAM_CALL(bitWrite, header.isFinal);
+			DSKFMT_STREAM_CALL(bitWrite, reinterpret_cast<const uint8_t*>(&header.compressionType), 2);
+		
+			// Write the rest of the header depending on the compression type
+
+			switch (header.compressionType)
+			{
+				case deflate::CompressionType::NoCompression:
+				{
+					_currentBlockCompressed = false;
+					_currentBlockRemainingSize = size;
+		
+					DSKFMT_STREAM_CALL(finishByte);
+					DSKFMT_STREAM_CALL(write, size);
+					DSKFMT_STREAM_CALL(write, static_cast<uint16_t>(~size));
+
+					break;
+				}
+				case deflate::CompressionType::FixedHuffman:
+				{
+					_currentBlockCompressed = true;
+
+					_setFixedCodes();
+		
+					break;
+				}
+				case deflate::CompressionType::DynamicHuffman:
+				{
+					_currentBlockCompressed = true;
+
+					DSK_CALL(_writeDynamicHeader, header.litlenCodeLengths, header.distCodeLengths);
+					_setCodes(header.litlenCodeLengths, header.distCodeLengths);
+
+					break;
+				}
+			}
+		}
+		
+		void DeflateOStream::writeBlockData(const uint8_t* data, uint64_t size)
+		{
+			DSKFMT_BEGIN();
+		
+			assert(_writingBlock);
+		
+			uint64_t sizeAppended;
+
+			if (_currentBlockCompressed)
+			{
+				// Compress as soon as enough bytes are known to find the longest matches
+
+				while (size)
+				{
+					_appendToWindow(data, size, sizeAppended);
+					data += sizeAppended;
+					size -= sizeAppended;
+
+					DSK_CALL(_compress, false);
+				}
+			}
+			else
+			{
+				assert(_currentBlockRemainingSize >= size);
+				assert(_lookahead == 0);
+		
+				DSKFMT_STREAM_CALL(write, data, size);
+				_currentBlockRemainingSize -= size;
+
+				// Keep the data as history for the next compressed blocks, without hashing it
+
+				while (size)
+				{
+					_appendToWindow(data, size, sizeAppended);
+					data += sizeAppended;
+					size -= sizeAppended;
+
+					_windowIndex += _lookahead;
+					_lookahead = 0;
+					_hashIndex = _windowIndex;
+				}
+			}
+		}
+		
+		void DeflateOStream::writeBlockEnd()
+		{
+			DSKFMT_BEGIN();
+		
+			assert(_writingBlock);
+		
+			if (_currentBlockCompressed)
+			{
+				DSK_CALL(_compress, true);
+
+				if (_automaticCodes)
+				{
+					DSK_CALL(_writeAutomaticBlock, _writingLastBlock);
+				}
+				else
+				{
+					_symbols.push_back({ 256, 0 });
+					DSK_CALL(_writeSymbols);
+
+					_codes = nullptr;
+				}
+
+				_automaticCodes = false;
+				_currentBlockCompressed = false;
+				_currentBlockRemainingSize = 0;
+			}
+			else
+			{
+				assert(_currentBlockRemainingSize == 0);
+			}
+
+			_writingBlock = false;
+			if (_writingLastBlock)
+			{
+				_writingLastBlock = false;
+				_bytesWritten = 0;
+				_resetWindow();
+
+				DSKFMT_STREAM_CALL(finishByte);
+			}
+		}
+
+		void DeflateOStream::setLevel(uint8_t level)
+		{
+			assert(level >= 1 && level <= 10);
+
+			_level = level;
+		}
+
+		void DeflateOStream::setStrategy(deflate::Strategy strategy)
+		{
+			_strategy = strategy;
+		}
+
+		void DeflateOStream::setDictionary(const uint8_t* data, uint64_t size)
+		{
+			assert(!_writingBlock);
+			assert(!_bytesWritten);
+
+			// Only the bytes in reach of the matches are kept, and hashed as any history
+
+			const uint64_t dictionarySize = std::min<uint64_t>(size, _maxDistance);
+
+			_resetWindow();
+			std::copy_n(data + size - dictionarySize, dictionarySize, _window.data());
+			_windowIndex = dictionarySize;
+			_updateHash(_windowIndex);
+		}
+		
+		void DeflateOStream::flush(deflate::FlushMode mode)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_writingBlock || _automaticCodes);
+
+			// End the current block with all the data given, its next data being written in another block
+
+			if (_writingBlock)
+			{
+				DSK_CALL(_compress, true);
+				DSK_CALL(_writeAutomaticBlock, false);
+			}
+
+			// The empty stored block pads the output to the next byte, and is not final whatever the current block is
+
+			static constexpr deflate::CompressionType compressionType = deflate::CompressionType::NoCompression;
+			static constexpr uint16_t size = 0;
+
+			DSKFMT_STREAM_CALL(bitWrite, false);
+			DSKFMT_STREAM_CALL(bitWrite, reinterpret_cast<const uint8_t*>(&compressionType), 2);
+			DSKFMT_STREAM_CALL(finishByte);
+			DSKFMT_STREAM_CALL(write, size);
+			DSKFMT_STREAM_CALL(write, static_cast<uint16_t>(~size));
+
+			if (mode == deflate::FlushMode::Full)
+			{
+				_resetWindow();
+			}
+
+			DSKFMT_STREAM_CALL(flush);
+		}
+
+		void DeflateOStream::saveState(deflate::OStreamState& state)
+		{
+			DSKFMT_BEGIN();
+
+			// After the flush, all the data given is written and the output ends on a byte
+
+			DSK_CALL(flush, deflate::FlushMode::Sync);
+
+			assert(_lookahead == 0);
+
+			state.inputPosition = _bytesWritten;
+			state.writingBlock = _writingBlock;
+			state.writingLastBlock = _writingLastBlock;
+			state.level = _level;
+			state.strategy = _strategy;
+
+			const uint32_t windowSize = std::min<uint32_t>(_windowIndex, _maxDistance);
+			state.window.assign(_window.begin() + _windowIndex - windowSize, _window.begin() + _windowIndex);
+		}
+
+		void DeflateOStream::restoreState(const deflate::OStreamState& state)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_writingBlock);
+			assert(!_bytesWritten);
+
+			DSK_CHECK(state.level >= 1 && state.level <= 10, "State level must be between 1 and 10.");
+			DSK_CHECK(state.strategy <= deflate::Strategy::Rle, "State strategy is unknown.");
+
+			_level = state.level;
+			_strategy = state.strategy;
+
+			// The window is hashed again, as a dictionary
+
+			setDictionary(state.window.data(), state.window.size());
+			_bytesWritten = state.inputPosition;
+
+			// A block with automatic codes goes on as a new block, the previous one having been ended by the flush
+
+			if (state.writingBlock)
+			{
+				_writingBlock = true;
+				_writingLastBlock = state.writingLastBlock;
+				_automaticCodes = true;
+				_currentBlockCompressed = true;
+				_startAutomaticBlock();
+			}
+		}
+		
+
+		void DeflateOStream::setStreamState()
+		{
+			_stream->setBitEndianness(std::endian::little);
+			_stream->setByteEndianness(std::endian::little);
+		}
+
+		void DeflateOStream::resetFormatState()
+		{
+			_codes = nullptr;
+			_writingBlock = false;
+			_writingLastBlock = false;
+			_currentBlockCompressed = false;
+			_automaticCodes = false;
+			_currentBlockRemainingSize = 0;
+			_bytesWritten = 0;
+			_resetWindow();
+			_symbols.clear();
+		}
+
+		void DeflateOStream::_appendToWindow(const uint8_t* data, uint64_t size, uint64_t& sizeAppended)
+		{
+			if (_windowIndex + _lookahead == 2 * _windowSize)
+			{
+				_slideWindow();
+			}
+
+			sizeAppended = std::min<uint64_t>(size, 2 * _windowSize - _windowIndex - _lookahead);
+			std::copy_n(data, sizeAppended, _window.data() + _windowIndex + _lookahead);
+			_lookahead += sizeAppended;
+			_bytesWritten += sizeAppended;
+		}
+
+		void DeflateOStream::_slideWindow()
+		{
+			// The bytes waiting to be compressed always fit in the second half, as they are fewer than _minLookahead
+
+			assert(_windowIndex >= _windowSize && _hashIndex >= _windowSize);
+
+			std::copy_n(_window.data() + _windowSize, _windowSize, _window.data());
+			_windowIndex -= _windowSize;
+			_hashIndex -= _windowSize;
+			_blockBytesAvailable = _blockBytesAvailable && _blockSize <= _windowIndex;
+
+			for (uint16_t& position : _hashHeads)
+			{
+				position = position >= _windowSize ? position - _windowSize : 0;
+			}
+			for (uint16_t& position : _hashChains)
+			{
+				position = position >= _windowSize ? position - _windowSize : 0;
+			}
+		}
+
+		void DeflateOStream::_resetWindow()
+		{
+			_windowIndex = 0;
+			_lookahead = 0;
+			_hashIndex = 0;
+			std::fill(_hashHeads.begin(), _hashHeads.end(), 0);
+		}
+
+		void DeflateOStream::_updateHash(uint32_t end)
+		{
+			// A position can only be hashed once its three first bytes are known
+
+			end = std::min(end, _windowIndex + _lookahead - std::min<uint32_t>(_windowIndex + _lookahead, _minMatchLength - 1));
+			for (; _hashIndex < end; ++_hashIndex)
+			{
+				const uint32_t hash = hashBytes(_window.data() + _hashIndex, _hashBits);
+				_hashChains[_hashIndex & _windowIndexFilter] = _hashHeads[hash];
+				_hashHeads[hash] = _hashIndex;
+			}
+		}
+
+		uint16_t DeflateOStream::_findMatch(uint32_t position, uint16_t minLength, uint16_t& distance)
+		{
+			const LevelConfig& config = levelConfigs[_level];
+
+			_updateHash(position + 1);
+
+			const uint32_t available = _windowIndex + _lookahead - position;
+			const uint16_t maxLength = std::min<uint32_t>(available, _maxMatchLength);
+			if (maxLength < _minMatchLength || minLength >= maxLength || _hashIndex <= position)
+			{
+				return 0;
+			}
+
+			const uint16_t niceLength = std::min(config.niceLength, maxLength);
+			const uint32_t limit = position > _maxDistance ? position - _maxDistance : 0;
+			uint32_t chainLength = minLength >= config.goodLength ? config.maxChain >> 2 : config.maxChain;
+
+			const uint8_t* current = _window.data() + position;
+			uint16_t bestLength = std::max<uint16_t>(minLength, _minMatchLength - 1);
+
+			// Positions are inserted in increasing order, so following the chain always goes back in the window
+
+			for (uint32_t candidate = _hashChains[position & _windowIndexFilter]; candidate > limit && chainLength; candidate = _hashChains[candidate & _windowIndexFilter], --chainLength)
+			{
+				const uint8_t* match = _window.data() + candidate;
+				if (match[bestLength] != current[bestLength] || match[0] != current[0] || match[1] != current[1])
+				{
+					continue;
+				}
+
+				const uint16_t length = _getEncodableLength(extendMatch(match, current, 2, maxLength), position - candidate);
+				if (length > bestLength)
+				{
+					bestLength = length;
+					distance = position - candidate;
+					if (length >= niceLength)
+					{
+						break;
+					}
+				}
+			}
+
+			if (bestLength <= minLength || bestLength < _minMatchLength || (bestLength == _minMatchLength && distance > tooFarDistance))
+			{
+				return 0;
+			}
+
+			return bestLength;
+		}
+
+		void DeflateOStream::_compress(bool flush)
+		{
+			DSKFMT_BEGIN();
+
+			if (_strategy != deflate::Strategy::Default)
+			{
+				DSK_CALL(_compressRuns, flush);
+				return;
+			}
+
+			const LevelConfig& config = levelConfigs[_level];
+			if (config.strategy == MatchStrategy::Optimal)
+			{
+				DSK_CALL(_compressOptimally, flush);
+				return;
+			}
+
+			const uint32_t minLookahead = flush ? 1 : _minLookahead;
+
+			while (_lookahead >= minLookahead)
+			{
+				DSK_CALL(_checkBlockEnd);
+
+				uint16_t distance;
+				uint16_t length = _findMatch(_windowIndex, 0, distance);
+
+				// Lazy evaluation: prefer literals if a longer match starts right after
+
+				if (config.strategy != MatchStrategy::Greedy)
+				{
+					while (length && length < config.maxLazy && _symbols.size() + 3 <= _maxSymbolCount)
+					{
+						uint16_t nextDistance;
+						uint16_t nextLength = _findMatch(_windowIndex + 1, length, nextDistance);
+						if (nextLength)
+						{
+							_pushLiteral(_window[_windowIndex]);
+							++_windowIndex;
+							--_lookahead;
+
+							length = nextLength;
+							distance = nextDistance;
+							continue;
+						}
+
+						if (config.strategy == MatchStrategy::Lazy2 && _lookahead > 2)
+						{
+							nextLength = _findMatch(_windowIndex + 2, length + 1, nextDistance);
+							if (nextLength)
+							{
+								_pushLiteral(_window[_windowIndex]);
+								_pushLiteral(_window[_windowIndex + 1]);
+								_windowIndex += 2;
+								_lookahead -= 2;
+
+								length = nextLength;
+								distance = nextDistance;
+								continue;
+							}
+						}
+
+						break;
+					}
+				}
+
+				if (length)
+				{
+					_pushMatch(length, distance);
+					_windowIndex += length;
+					_lookahead -= length;
+
+					// Greedy levels do not spend time hashing the bytes of long matches
+
+					if (config.strategy == MatchStrategy::Greedy && length > config.maxLazy)
+					{
+						_hashIndex = std::max(_hashIndex, _windowIndex);
+					}
+				}
+				else
+				{
+					_pushLiteral(_window[_windowIndex]);
+					++_windowIndex;
+					--_lookahead;
+				}
+			}
+		}
+
+		void DeflateOStream::_compressRuns(bool flush)
+		{
+			DSKFMT_BEGIN();
+
+			const uint32_t minLookahead = flush ? 1 : _minLookahead;
+			const bool findRuns = _strategy == deflate::Strategy::Rle;
+
+			while (_lookahead >= minLookahead)
+			{
+				DSK_CALL(_checkBlockEnd);
+
+				// A run is a match at distance 1, which only needs the previous byte
+
+				const uint8_t* current = _window.data() + _windowIndex;
+				const uint16_t maxLength = std::min<uint32_t>(_lookahead, _maxMatchLength);
+				uint16_t length = 0;
+
+				if (findRuns && _windowIndex && maxLength >= _minMatchLength && current[0] == current[-1] && current[1] == current[-1] && current[2] == current[-1])
+				{
+					length = _getEncodableLength(extendMatch(current - 1, current, _minMatchLength, maxLength), 1);
+				}
+
+				if (length)
+				{
+					_pushMatch(length, 1);
+					_windowIndex += length;
+					_lookahead -= length;
+				}
+				else
+				{
+					_pushLiteral(*current);
+					++_windowIndex;
+					--_lookahead;
+				}
+			}
+
+			// The hash chains are not needed, the positions compressed are skipped if a level is set again
+
+			_hashIndex = std::max(_hashIndex, _windowIndex);
+		}
+
+		void DeflateOStream::_findMatches(uint32_t position)
+		{
+			const LevelConfig& config = levelConfigs[_level];
+
+			_updateHash(position + 1);
+
+			const uint32_t available = _windowIndex + _lookahead - position;
+			const uint16_t maxLength = std::min<uint32_t>(available, _maxMatchLength);
+			if (maxLength < _minMatchLength || _hashIndex <= position)
+			{
+				return;
+			}
+
+			const uint32_t limit = position > _maxDistance ? position - _maxDistance : 0;
+			uint32_t chainLength = config.maxChain;
+
+			const uint8_t* current = _window.data() + position;
+			uint16_t bestLength = _minMatchLength - 1;
+
+			// The chain goes back in the window, so each new longest match is the closest one of its length
+
+			for (uint32_t candidate = _hashChains[position & _windowIndexFilter]; candidate > limit && chainLength; candidate = _hashChains[candidate & _windowIndexFilter], --chainLength)
+			{
+				const uint8_t* match = _window.data() + candidate;
+				if (match[bestLength] != current[bestLength] || match[0] != current[0] || match[1] != current[1])
+				{
+					continue;
+				}
+
+				const uint16_t length = _getEncodableLength(extendMatch(match, current, 2, maxLength), position - candidate);
+				if (length > bestLength)
+				{
+					bestLength = length;
+					_matches.push_back({ length, static_cast<uint16_t>(position - candidate) });
+					if (length >= maxLength)
+					{
+						break;
+					}
+				}
+			}
+		}
+
+		uint16_t DeflateOStream::_getEncodableLength(uint16_t length, uint16_t distance) const
+		{
+			// Blocks with automatic codes encode any match, the codes given for a block may miss some length or distance
+			// symbols, the match is then shortened to the longest length with a code or dropped
+
+			if (!_codes)
+			{
+				return length;
+			}
+
+			if (_codes->dist[getDistCode(distance)].length == 0)
+			{
+				return 0;
+			}
+
+			while (length >= _minMatchLength && _codes->litlen[257 + lenCodes[length]].length == 0)
+			{
+				length = lenStart[lenCodes[length]] - 1;
+			}
+
+			return length >= _minMatchLength ? length : 0;
+		}
+
+		void DeflateOStream::_compressOptimally(bool flush)
+		{
+			DSKFMT_BEGIN();
+
+			// Segments are parsed once the window is full, so that they are as long as possible
+
+			if (!flush && _windowIndex + _lookahead != 2 * _windowSize)
+			{
+				return;
+			}
+
+			const uint32_t minLookahead = flush ? 1 : _minLookahead;
+
+			while (_lookahead >= minLookahead)
+			{
+				// The segment holds the positions whose longest matches are known
+
+				const uint32_t size = std::min<uint32_t>(_lookahead - minLookahead + 1, _optimalSegmentSize);
+
+				_matches.clear();
+				_matchOffsets.resize(size + 1);
+				for (uint32_t i = 0; i < size; ++i)
+				{
+					_matchOffsets[i] = _matches.size();
+					_findMatches(_windowIndex + i);
+
+					// The positions covered by a match of the maximum length are not searched, the match is always worth it
+
+					if (_matches.size() != _matchOffsets[i] && _matches.back().length == _maxMatchLength)
+					{
+						for (const uint32_t end = std::min<uint32_t>(i + _maxMatchLength, size); i + 1 < end; ++i)
+						{
+							_matchOffsets[i + 1] = _matches.size();
+						}
+					}
+				}
+				_matchOffsets[size] = _matches.size();
+
+				// The costs of the symbols start as their lengths with the fixed codes, then are updated from the code
+				// lengths given by the previous path. The codes given for a block are used as they are.
+
+				uint8_t codeLengths[320];
+				uint8_t passCount = _optimalPassCount;
+				if (_codes)
+				{
+					std::transform(_codes->litlen, _codes->litlen + 288, codeLengths, [](const Code& code) { return code.length; });
+					std::transform(_codes->dist, _codes->dist + 32, codeLengths + 288, [](const Code& code) { return code.length; });
+					passCount = 1;
+				}
+				else
+				{
+					std::copy_n(fixedCodeLengths.begin(), 320, codeLengths);
+				}
+
+				for (uint8_t pass = 0; pass < passCount; ++pass)
+				{
+					if (pass != 0)
+					{
+						uint64_t occurences[320] = {};
+						for (const Symbol& symbol : _path)
+						{
+							if (symbol.distance == 0)
+							{
+								++occurences[symbol.litlenOrLength];
+							}
+							else
+							{
+								++occurences[257 + lenCodes[symbol.litlenOrLength]];
+								++occurences[288 + getDistCode(symbol.distance)];
+							}
+						}
+						++occurences[256];
+
+						uint64_t codeLengths64bit[320];
+						uint64_t scratch[576];
+						occurencesToCodeLengths(occurences, codeLengths64bit, 288, 15, scratch);
+						occurencesToCodeLengths(occurences + 288, codeLengths64bit + 288, 32, 15, scratch);
+						std::copy_n(codeLengths64bit, 320, codeLengths);
+					}
+
+					_findCheapestPath(size, codeLengths);
+				}
+
+				// Symbols are pushed one by one, the blocks ending as for the other levels
+
+				for (const Symbol& symbol : _path)
+				{
+					DSK_CALL(_checkBlockEnd);
+
+					if (symbol.distance == 0)
+					{
+						_pushLiteral(symbol.litlenOrLength);
+						++_windowIndex;
+						--_lookahead;
+					}
+					else
+					{
+						_pushMatch(symbol.litlenOrLength, symbol.distance);
+						_windowIndex += symbol.litlenOrLength;
+						_lookahead -= symbol.litlenOrLength;
+					}
+				}
+			}
+		}
+
+		void DeflateOStream::_findCheapestPath(uint32_t size, const uint8_t* codeLengths)
+		{
+			// Symbols without a code may be chosen at the price of a long code, unless the codes of the block are given,
+			// the length and distance symbols without a code being then excluded
+
+			constexpr uint8_t unusedCodeLength = 15;
+			constexpr uint32_t excludedCost = UINT32_MAX;
+			const bool codesGiven = (_codes != nullptr);
+			const auto getCost = [&](uint16_t symbol) -> uint32_t
+			{
+				return codeLengths[symbol] ? codeLengths[symbol] : unusedCodeLength;
+			};
+			const auto getMatchSymbolCost = [&](uint16_t symbol) -> uint32_t
+			{
+				return codeLengths[symbol] || !codesGiven ? getCost(symbol) : excludedCost;
+			};
+
+			uint32_t literalCosts[256];
+			for (uint16_t i = 0; i < 256; ++i)
+			{
+				literalCosts[i] = getCost(i);
+			}
+
+			uint32_t lengthCosts[_maxMatchLength + 1];
+			for (uint16_t i = _minMatchLength; i <= _maxMatchLength; ++i)
+			{
+				const uint32_t cost = getMatchSymbolCost(257 + lenCodes[i]);
+				lengthCosts[i] = cost == excludedCost ? excludedCost : cost + lenExtraBits[lenCodes[i]];
+			}
+
+			// Shortest path from the beginning of the segment, in bits, each position being reached from a previous one
+
+			_pathNodes.assign(size + 1, { UINT32_MAX, 0, 0 });
+			_pathNodes[0].cost = 0;
+
+			const uint8_t* data = _window.data() + _windowIndex;
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				const uint32_t cost = _pathNodes[i].cost;
+
+				const uint32_t literalCost = cost + literalCosts[data[i]];
+				if (literalCost < _pathNodes[i + 1].cost)
+				{
+					_pathNodes[i + 1] = { literalCost, 1, 0 };
+				}
+
+				// Each length is reached with the closest match at least as long, matches do not go past the segment
+
+				uint16_t length = _minMatchLength;
+				for (uint32_t j = _matchOffsets[i]; j < _matchOffsets[i + 1]; ++j)
+				{
+					const Match& match = _matches[j];
+					const uint8_t distCode = getDistCode(match.distance);
+					if (getMatchSymbolCost(288 + distCode) == excludedCost)
+					{
+						continue;
+					}
+
+					const uint32_t distanceCost = cost + getCost(288 + distCode) + distExtraBits[distCode];
+
+					const uint16_t maxLength = std::min<uint32_t>(match.length, size - i);
+					for (; length <= maxLength; ++length)
+					{
+						if (lengthCosts[length] == excludedCost)
+						{
+							continue;
+						}
+
+						const uint32_t matchCost = distanceCost + lengthCosts[length];
+						if (matchCost < _pathNodes[i + length].cost)
+						{
+							_pathNodes[i + length] = { matchCost, length, match.distance };
+						}
+					}
+				}
+			}
+
+			// Walk the path back from the end of the segment
+
+			_path.clear();
+			for (uint32_t i = size; i != 0; i -= _pathNodes[i].length)
+			{
+				const PathNode& node = _pathNodes[i];
+				if (node.distance == 0)
+				{
+					_path.push_back({ data[i - 1], 0 });
+				}
+				else
+				{
+					_path.push_back({ node.length, node.distance });
+				}
+			}
+
+			std::reverse(_path.begin(), _path.end());
+		}
+
+		void DeflateOStream::_checkBlockEnd()
+		{
+			// A step writes at most three symbols, blocks with automatic codes are ended when the buffer is full. Blocks
+			// that may not be stored anymore are also ended as soon as the fixed codes make them larger than stored.
+
+			if (_automaticCodes)
+			{
+				const bool isExpanding = _blockSize >= _maxStoredBlockSize && _blockFixedBitCount > (_blockSize << 3);
+				if (_symbols.size() + 3 > _maxSymbolCount || isExpanding || (_newObservationCount >= _observationsPerCheck && _shouldEndBlock()))
+				{
+					DSK_CALL(_writeAutomaticBlock, false);
+				}
+			}
+			else if (_symbols.size() + 3 > _maxSymbolCount)
+			{
+				DSK_CALL(_writeSymbols);
+			}
+		}
+
+		void DeflateOStream::_writeSymbols()
+		{
+			DSKFMT_BEGIN();
+
+			uint8_t buffer[_singleBufferSize];
+			BitAccumulator accumulator{ buffer };
+
+			const Code* const litlenCodes = _codes->litlen;
+			const Code* const distCodes = _codes->dist;
+
+			for (const Symbol& symbol : _symbols)
+			{
+				if (symbol.distance == 0)
+				{
+					const Code& code = litlenCodes[symbol.litlenOrLength];
+					assert(code.length);
+					accumulator.append(code.bits, code.length);
+				}
+				else
+				{
+					const uint8_t lenCode = lenCodes[symbol.litlenOrLength];
+					const Code& lengthSymbolCode = litlenCodes[257 + lenCode];
+					assert(lengthSymbolCode.length);
+					accumulator.append(lengthSymbolCode.bits, lengthSymbolCode.length);
+					accumulator.append(symbol.litlenOrLength - lenStart[lenCode], lenExtraBits[lenCode]);
+
+					const uint8_t distCode = getDistCode(symbol.distance);
+					assert(distCodes[distCode].length);
+					accumulator.append(distCodes[distCode].bits, distCodes[distCode].length);
+					accumulator.append(symbol.distance - distStart[distCode], distExtraBits[distCode]);
+				}
+
+				if (accumulator.byteCount + 16 > _singleBufferSize)
+				{
+					DSKFMT_STREAM_CALL(bitWrite, buffer, accumulator.byteCount << 3);
+					accumulator.byteCount = 0;
+				}
+			}
+
+			// The last byte is completed by the next write
+
+			DSKFMT_STREAM_CALL(bitWrite, buffer, accumulator.finish());
+
+			_symbols.clear();
+		}
+
+		void DeflateOStream::_computeCodes(const uint64_t* codeLengths, uint16_t symbolCount, Code* codes)
+		{
+			assert(symbolCount <= 288);
+
+			uint64_t canonicalCodes[288];
+			const bool success = _dsk::huffmanCodeLengthsToCodes(codeLengths, canonicalCodes, symbolCount);
+			assert(success);
+
+			for (uint16_t i = 0; i < symbolCount; ++i)
+			{
+				codes[i] = { static_cast<uint16_t>(_dsk::huffmanReverseCode(canonicalCodes[i], codeLengths[i])), static_cast<uint8_t>(codeLengths[i]) };
+			}
+		}
+
+		const DeflateOStream::Codes& DeflateOStream::_getFixedCodes()
+		{
+			// Built once for all the streams, on the first block with fixed codes
+
+			static const Codes codes = []()
+			{
+				Codes codes;
+				uint64_t codeLengths[320];
+				std::copy_n(fixedCodeLengths.begin(), 320, codeLengths);
+
+				_computeCodes(codeLengths, 288, codes.litlen);
+				_computeCodes(codeLengths + 288, 32, codes.dist);
+
+				return codes;
+			}();
+
+			return codes;
+		}
+
+		void DeflateOStream::_setCodes(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths)
+		{
+			uint64_t codeLengths[288];
+
+			std::copy_n(litlenCodeLengths, 288, codeLengths);
+			_computeCodes(codeLengths, 288, _dynamicCodes.litlen);
+
+			std::copy_n(distCodeLengths, 32, codeLengths);
+			_computeCodes(codeLengths, 32, _dynamicCodes.dist);
+
+			_codes = &_dynamicCodes;
+		}
+
+		void DeflateOStream::_setFixedCodes()
+		{
+			_codes = &_getFixedCodes();
+		}
+
+		void DeflateOStream::_writeDynamicHeader(const uint8_t* litlenCodeLengths, const uint8_t* distCodeLengths)
+		{
+			DSKFMT_BEGIN();
+
+			DynamicHeader header;
+			computeDynamicHeader(litlenCodeLengths, distCodeLengths, header);
+
+			Code codeLengthCodes[19];
+			_computeCodes(header.codeLengths, 19, codeLengthCodes);
+
+			// Write HLIT, HDIST, HCLEN, the code lengths of the code length alphabet and the run-length encoded sequence
+
+			static constexpr uint8_t runExtraBits[19] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7 };
+
+			uint8_t buffer[1024];
+			BitAccumulator accumulator{ buffer };
+
+			accumulator.append(header.hlit - 257, 5);
+			accumulator.append(header.hdist - 1, 5);
+			accumulator.append(header.hclen - 4, 4);
+			for (uint8_t i = 0; i < header.hclen; ++i)
+			{
+				accumulator.append(header.codeLengths[codeLengthsOrder[i]], 3);
+			}
+
+			for (uint16_t i = 0; i < header.runCount; ++i)
+			{
+				const Code& code = codeLengthCodes[header.runSymbols[i]];
+				accumulator.append(code.bits, code.length);
+				accumulator.append(header.runExtras[i], runExtraBits[header.runSymbols[i]]);
+			}
+
+			DSKFMT_STREAM_CALL(bitWrite, buffer, accumulator.finish());
+		}
+
+		void DeflateOStream::_writeAutomaticBlock(bool isFinal)
+		{
+			DSKFMT_BEGIN();
+
+			assert(_automaticCodes);
+
+			// An empty block is only needed to end the stream
+
+			if (_blockSize == 0 && !isFinal)
+			{
+				return;
+			}
+
+			// Compute the dynamic code lengths from the occurences of the symbols, the end of block included
+
+			uint64_t occurences[320] = {};
+			for (const Symbol& symbol : _symbols)
+			{
+				if (symbol.distance == 0)
+				{
+					++occurences[symbol.litlenOrLength];
+				}
+				else
+				{
+					++occurences[257 + lenCodes[symbol.litlenOrLength]];
+					++occurences[288 + getDistCode(symbol.distance)];
+				}
+			}
+			++occurences[256];
+
+			// The occurences are copied as occurencesToCodeLengths may add some, which must not count in the size of the block
+
+			uint64_t codeLengths[320];
+			uint64_t usedOccurences[320];
+			uint64_t scratch[576];
+			std::copy_n(occurences, 320, usedOccurences);
+			occurencesToCodeLengths(usedOccurences, codeLengths, 288, 15, scratch);
+			occurencesToCodeLengths(usedOccurences + 288, codeLengths + 288, 32, 15, scratch);
+
+			uint8_t codeLengths8bit[320];
+			std::copy_n(codeLengths, 320, codeLengths8bit);
+
+			// Choose the block type with the exact size of each one, stored blocks being only possible if the data is still in the window
+
+			DynamicHeader dynamicHeader;
+			computeDynamicHeader(codeLengths8bit, codeLengths8bit + 288, dynamicHeader);
+
+			const uint64_t dynamicBitCount = 3 + dynamicHeader.bitCount + getSymbolsBitCount(occurences, codeLengths8bit);
+			const uint64_t fixedBitCount = 3 + getSymbolsBitCount(occurences, fixedCodeLengths.data());
+
+			const uint64_t storedBlockCount = std::max<uint64_t>((_blockSize + 65534) / 65535, 1);
+			const uint64_t storedBitCount = _blockBytesAvailable ? storedBlockCount * (3 + 7 + 32) + (_blockSize << 3) : UINT64_MAX;
+
+			if (storedBitCount <= std::min(dynamicBitCount, fixedBitCount))
+			{
+				static constexpr deflate::CompressionType compressionType = deflate::CompressionType::NoCompression;
+
+				const uint8_t* data = _window.data() + _windowIndex - _blockSize;
+				uint64_t remainingSize = _blockSize;
+				do
+				{
+					const uint16_t size = std::min<uint64_t>(remainingSize, 65535);
+					remainingSize -= size;
+
+					DSKFMT_STREAM_CALL(bitWrite, isFinal && !remainingSize);
+					DSKFMT_STREAM_CALL(bitWrite, reinterpret_cast<const uint8_t*>(&compressionType), 2);
+					DSKFMT_STREAM_CALL(finishByte);
+					DSKFMT_STREAM_CALL(write, size);
+					DSKFMT_STREAM_CALL(write, static_cast<uint16_t>(~size));
+					DSKFMT_STREAM_CALL(write, data, size);
+
+					data += size;
+				} while (remainingSize);
+
+				_symbols.clear();
+			}
+			else
+			{
+				const deflate::CompressionType compressionType = fixedBitCount <= dynamicBitCount ? deflate::CompressionType::FixedHuffman : deflate::CompressionType::DynamicHuffman;
+
+				DSKFMT_STREAM_CALL(bitWrite, isFinal);
+				DSKFMT_STREAM_CALL(bitWrite, reinterpret_cast<const uint8_t*>(&compressionType), 2);
+
+				if (compressionType == deflate::CompressionType::FixedHuffman)
+				{
+					_setFixedCodes();
+				}
+				else
+				{
+					DSK_CALL(_writeDynamicHeader, codeLengths8bit, codeLengths8bit + 288);
+					_setCodes(codeLengths8bit, codeLengths8bit + 288);
+				}
+
+				_symbols.push_back({ 256, 0 });
+				DSK_CALL(_writeSymbols);
+
+				_codes = nullptr;
+			}
+
+			_startAutomaticBlock();
+		}
+
+		void DeflateOStream::_startAutomaticBlock()
+		{
+			_blockSize = 0;
+			_blockBytesAvailable = true;
+			_blockFixedBitCount = 0;
+			std::fill_n(_observations, _observationTypeCount, 0);
+			std::fill_n(_newObservations, _observationTypeCount, 0);
+			_observationCount = 0;
+			_newObservationCount = 0;
+		}
+
+		void DeflateOStream::_pushLiteral(uint8_t literal)
+		{
+			_symbols.push_back({ literal, 0 });
+
+			// Literals are observed by their highest bits, which separate text from binary data, and by their parity
+
+			if (_automaticCodes)
+			{
+				++_blockSize;
+				_blockFixedBitCount += fixedCodeLengths[literal];
+				++_newObservations[((literal >> 5) & 0x6) | (literal & 1)];
+				++_newObservationCount;
+			}
+		}
+
+		void DeflateOStream::_pushMatch(uint16_t length, uint16_t distance)
+		{
+			_symbols.push_back({ length, distance });
+
+			if (_automaticCodes)
+			{
+				const uint8_t lenCode = lenCodes[length];
+				_blockSize += length;
+				_blockFixedBitCount += fixedCodeLengths[257 + lenCode] + lenExtraBits[lenCode] + fixedCodeLengths[288] + distExtraBits[getDistCode(distance)];
+				++_newObservations[8 + (length >= 9)];
+				++_newObservationCount;
+			}
+		}
+
+		bool DeflateOStream::_shouldEndBlock()
+		{
+			// End the block when the distribution of the last symbols differs too much from the one of the block
+
+			bool endBlock = false;
+			if (_observationCount > 0 && _blockSize >= minSplitBlockSize)
+			{
+				uint64_t totalDelta = 0;
+				for (uint8_t i = 0; i < _observationTypeCount; ++i)
+				{
+					const uint64_t expected = static_cast<uint64_t>(_observations[i]) * _newObservationCount;
+					const uint64_t actual = static_cast<uint64_t>(_newObservations[i]) * _observationCount;
+					totalDelta += expected > actual ? expected - actual : actual - expected;
+				}
+
+				// Long blocks are split more easily, as the cost of a new header matters less
+
+				const uint64_t cutoff = static_cast<uint64_t>(_newObservationCount) * 200 / 512 * _observationCount;
+				endBlock = totalDelta + (_blockSize / 4096) * _observationCount >= cutoff;
+			}
+
+			if (!endBlock)
+			{
+				for (uint8_t i = 0; i < _observationTypeCount; ++i)
+				{
+					_observations[i] += _newObservations[i];
+					_newObservations[i] = 0;
+				}
+				_observationCount += _newObservationCount;
+				_newObservationCount = 0;
+			}
+
+			return endBlock;
+		}
+
+		namespace deflate
+		{
+			const Checkpoint* findCheckpoint(const Index& index, uint64_t outputPosition)
+			{
+				const auto it = std::upper_bound(index.checkpoints.begin(), index.checkpoints.end(), outputPosition, [](uint64_t position, const Checkpoint& checkpoint) { return position < checkpoint.outputPosition; });
+				return it == index.checkpoints.begin() ? nullptr : &*std::prev(it);
+			}
+
+			uint64_t inflate(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, std::span<const uint8_t> dictionary)
+			{
+				MemoryInput input = { src.data(), src.size() };
+				IStream stream(&input, readMemory, isMemoryEnded);
+				DeflateIStream deflateStream(&stream);
+				deflateStream.setDictionary(dictionary.data(), dictionary.size());
+
+				// Each block is decoded in place, until the final one
+
+				BlockHeader header;
+				uint64_t size = 0;
+				uint64_t sizeRead;
+				do {
+					deflateStream.readBlockHeader(header);
+					RUC_RELAYCOPY(deflateStream.getStatus(), status, 0);
+
+					deflateStream.readBlockData(dst.data() + size, dst.size() - size, sizeRead);
+					RUC_RELAYCOPY(deflateStream.getStatus(), status, 0);
+					size += sizeRead;
+
+					if (size == dst.size())
+					{
+						uint8_t byte;
+						deflateStream.readBlockData(&byte, 1, sizeRead);
+						RUC_RELAYCOPY(deflateStream.getStatus(), status, 0);
+						RUC_CHECK(status, 0, sizeRead == 0, "The destination is too small for the inflated data.");
+					}
+
+					deflateStream.readBlockEnd();
+					RUC_RELAYCOPY(deflateStream.getStatus(), status, 0);
+				} while (!header.isFinal);
+
+				return size;
+			}
+
+			uint64_t findBlockStart(std::span<const uint8_t> src, uint64_t bitPosition, uint64_t endBitPosition)
+			{
+				endBitPosition = std::min<uint64_t>(endBitPosition, src.size() << 3);
+
+				// Bits are loaded once per byte, and most positions are rejected by the fields of the first two bytes
+
+				while (bitPosition < endBitPosition)
+				{
+					const uint64_t bits = peekBits(src, bitPosition & ~7ull);
+					for (uint8_t offset = bitPosition & 7; offset != 8 && bitPosition < endBitPosition; ++offset, ++bitPosition)
+					{
+						const uint64_t header = bits >> offset;
+						if ((header & 7) == 0b100 && ((header >> 3) & 31) <= 29 && ((header >> 8) & 31) <= 29 && isDynamicBlockStart(src, bitPosition))
+						{
+							return bitPosition;
+						}
+					}
+				}
+
+				return endBitPosition;
+			}
+
+			void resolveChunk(const Chunk& chunk, std::span<const uint8_t> window, std::span<uint8_t> dst, ruc::Status& status)
+			{
+				assert(dst.size() >= chunk.data.size());
+
+				const bool success = resolveMarkers(chunk.data.data(), 0, chunk.data.size(), window.data(), window.size(), dst.data());
+				RUC_CHECK(status, RUC_VOID, success, "Distance code goes further than beginning of deflate stream window.");
+			}
+
+			uint64_t inflateChunks(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint64_t chunkSize, const TaskRunner& taskRunner)
+			{
+				assert(chunkSize != 0);
+
+				const uint64_t chunkCount = src.size() / chunkSize;
+				if (chunkCount < 2)
+				{
+					return inflate(src, dst, status);
+				}
+
+				// Look for a block start in each chunk, the chunks where none is found are merged with the previous one
+
+				std::vector<Chunk> chunks(chunkCount);
+				runTasks(taskRunner, chunkCount, [&](uint64_t i)
+				{
+					const uint64_t endBitPosition = (i + 1 == chunkCount ? src.size() : (i + 1) * chunkSize) << 3;
+					chunks[i].beginBitPosition = (i == 0 ? 0 : findBlockStart(src, (i * chunkSize) << 3, endBitPosition));
+					chunks[i].endBitPosition = endBitPosition;
+				});
+
+				std::erase_if(chunks, [](const Chunk& chunk) { return chunk.beginBitPosition == chunk.endBitPosition; });
+
+				// Decode each chunk up to the beginning of the next one
+
+				std::vector<uint8_t> decoded(chunks.size(), false);
+				runTasks(taskRunner, chunks.size(), [&](uint64_t i)
+				{
+					Chunk& chunk = chunks[i];
+					const bool isLast = (i + 1 == chunks.size());
+					const uint64_t endBitPosition = (isLast ? src.size() << 3 : chunks[i + 1].beginBitPosition);
+
+					MemoryInput input = { src.data() + (chunk.beginBitPosition >> 3), src.size() - (chunk.beginBitPosition >> 3) };
+					IStream stream(&input, readMemory, isMemoryEnded);
+					DeflateIStream deflateStream(&stream);
+
+					deflateStream.readChunk(chunk, endBitPosition);
+
+					// The final block ends anywhere in its last byte, the other chunks end exactly where the next one begins
+
+					if (isLast)
+					{
+						decoded[i] = static_cast<bool>(deflateStream.getStatus()) && chunk.isLast && ((chunk.endBitPosition + 7) >> 3) <= src.size();
+					}
+					else
+					{
+						decoded[i] = static_cast<bool>(deflateStream.getStatus()) && chunk.endBitPosition == endBitPosition;
+					}
+				});
+
+				// A chunk that does not end where the next one begins means that a block start was wrong, or that the
+				// stream is invalid, which the serial decoding reports
+
+				std::vector<uint64_t> offsets(chunks.size() + 1, 0);
+				for (uint64_t i = 0; i < chunks.size(); ++i)
+				{
+					if (!decoded[i])
+					{
+						return inflate(src, dst, status);
+					}
+
+					offsets[i + 1] = offsets[i] + chunks[i].data.size();
+				}
+
+				if (!chunks.back().isLast || offsets.back() > dst.size())
+				{
+					return inflate(src, dst, status);
+				}
+
+				// The last 32 KiB of each chunk are the window of the next one, then the chunks can be resolved apart
+
+				for (uint64_t i = 0; i < chunks.size(); ++i)
+				{
+					const uint64_t begin = chunks[i].data.size() - std::min<uint64_t>(chunks[i].data.size(), markerWindowSize);
+					if (!resolveMarkers(chunks[i].data.data(), begin, chunks[i].data.size(), dst.data(), offsets[i], dst.data() + offsets[i]))
+					{
+						return inflate(src, dst, status);
+					}
+				}
+
+				std::vector<uint8_t> resolved(chunks.size(), false);
+				runTasks(taskRunner, chunks.size(), [&](uint64_t i)
+				{
+					const uint64_t end = chunks[i].data.size() - std::min<uint64_t>(chunks[i].data.size(), markerWindowSize);
+					resolved[i] = resolveMarkers(chunks[i].data.data(), 0, end, dst.data(), offsets[i], dst.data() + offsets[i]);
+				});
+
+				if (std::find(resolved.begin(), resolved.end(), false) != resolved.end())
+				{
+					return inflate(src, dst, status);
+				}
+
+				return offsets.back();
+			}
+
+			uint64_t deflate(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint8_t level, Strategy strategy)
+			{
+				return deflatePart(src, {}, true, dst, status, level, strategy);
+			}
+
+			uint64_t deflateBound(uint64_t srcSize)
+			{
+				// A block with automatic codes is never larger than stored, which costs 42 bits per 65535 bytes at most,
+				// or than with the fixed codes once it cannot be stored anymore, which exceed the stored size by the end
+				// of block and the last step of the matcher at most. The blocks before the last one hold at least
+				// minSplitBlockSize bytes, and the last one can be empty.
+
+				const uint64_t blockCount = srcSize / minSplitBlockSize + 2;
+				return srcSize + 14 * blockCount + 6 * (srcSize / 65535);
+			}
+
+			uint64_t deflatePart(std::span<const uint8_t> src, std::span<const uint8_t> dictionary, bool isLast, std::span<uint8_t> dst, ruc::Status& status, uint8_t level, Strategy strategy)
+			{
+				MemoryOutput output = { dst.data(), dst.size(), 0 };
+				OStream stream(&output, writeMemory);
+				DeflateOStream deflateStream(&stream);
+				deflateStream.setLevel(level);
+				deflateStream.setStrategy(strategy);
+				deflateStream.setDictionary(dictionary.data(), dictionary.size());
+
+				// Writes fail only if dst is full
+
+				BlockHeader header = {};
+				header.isFinal = isLast;
+				header.compressionType = CompressionType::DynamicHuffman;
+
+				deflateStream.writeBlockHeader(header);
+				RUC_CHECK(status, 0, deflateStream.getStatus(), "The destination is too small for the deflated data.");
+				deflateStream.writeBlockData(src.data(), src.size());
+				RUC_CHECK(status, 0, deflateStream.getStatus(), "The destination is too small for the deflated data.");
+				deflateStream.writeBlockEnd();
+				RUC_CHECK(status, 0, deflateStream.getStatus(), "The destination is too small for the deflated data.");
+
+				if (!isLast)
+				{
+					header.compressionType = CompressionType::NoCompression;
+
+					deflateStream.writeBlockHeader(header, 0);
+					RUC_CHECK(status, 0, deflateStream.getStatus(), "The destination is too small for the deflated data.");
+					deflateStream.writeBlockEnd();
+					RUC_CHECK(status, 0, deflateStream.getStatus(), "The destination is too small for the deflated data.");
+				}
+
+				stream.flush();
+				RUC_CHECK(status, 0, stream.getStatus(), "The destination is too small for the deflated data.");
+
+				return output.sizeWritten;
+			}
+
+			uint64_t deflatePartBound(uint64_t srcSize)
+			{
+				// The empty stored block takes 42 bits at most
+
+				return deflateBound(srcSize) + 6;
+			}
+
+			uint64_t deflateChunks(std::span<const uint8_t> src, std::span<uint8_t> dst, ruc::Status& status, uint64_t chunkSize, uint8_t level, Strategy strategy, const TaskRunner& taskRunner)
+			{
+				assert(chunkSize != 0);
+
+				const uint64_t chunkCount = (src.size() + chunkSize - 1) / chunkSize;
+				if (chunkCount < 2)
+				{
+					return deflate(src, dst, status, level, strategy);
+				}
+
+				// Each part is encoded in its own buffer, primed with the 32 KiB preceding its chunk
+
+				std::vector<std::vector<uint8_t>> parts(chunkCount);
+				std::vector<ruc::Status> statuses(chunkCount);
+				runTasks(taskRunner, chunkCount, [&](uint64_t i)
+				{
+					const uint64_t begin = i * chunkSize;
+					const uint64_t size = std::min<uint64_t>(chunkSize, src.size() - begin);
+					const uint64_t dictionarySize = std::min<uint64_t>(begin, 32768);
+
+					parts[i].resize(deflatePartBound(size));
+					const uint64_t partSize = deflatePart(src.subspan(begin, size), src.subspan(begin - dictionarySize, dictionarySize), i + 1 == chunkCount, parts[i], statuses[i], level, strategy);
+					parts[i].resize(partSize);
+				});
+
+				// The parts but the last one end on a byte, they are simply concatenated
+
+				uint64_t size = 0;
+				for (uint64_t i = 0; i < chunkCount; ++i)
+				{
+					RUC_RELAYCOPY(statuses[i], status, 0);
+					RUC_CHECK(status, 0, parts[i].size() <= dst.size() - size, "The destination is too small for the deflated data.");
+
+					std::copy(parts[i].begin(), parts[i].end(), dst.data() + size);
+					size += parts[i].size();
+				}
+
+				return size;
+			}
+
+			uint64_t deflateChunksBound(uint64_t srcSize, uint64_t chunkSize)
+			{
+				assert(chunkSize != 0);
+
+				const uint64_t chunkCount = (srcSize + chunkSize - 1) / chunkSize;
+				if (chunkCount < 2)
+				{
+					return deflateBound(srcSize);
+				}
+
+				return (chunkCount - 1) * deflatePartBound(chunkSize) + deflatePartBound(srcSize - (chunkCount - 1) * chunkSize);
+			}
 		}
 	}
 }
@@ -33,16 +33,84 @@ namespace dsk
 				return x == '.' || isFirstIntegerChar(x);
 			}
 
-			constexpr uint64_t hashToken(const char* token)
+			enum class Keyword
 			{
-				uint64_t h = 0xEDB88320;
-				while (*token)
-				{
-					h = (h << 4) + h + *token;
-					++token;
-				}
-				return h;
-			}
+				Comment,
+				Bevel,
+				Bmat,
+				CInterp,
+				Con,
+				Cstype,
+				Ctech,
+				Curv,
+				Curv2,
+				DInterp,
+				Deg,
+				End,
+				F,
+				G,
+				Hole,
+				L,
+				Lod,
+				Mg,
+				Mtllib,
+				O,
+				P,
+				Parm,
+				S,
+				Scrv,
+				ShadowObj,
+				Sp,
+				Stech,
+				Step,
+				Surf,
+				TraceObj,
+				Trim,
+				Usemtl,
+				V,
+				Vn,
+				Vp,
+				Vt
+			};
+
+			constexpr auto keywords = makeConstLookupTable<std::string_view, Keyword>({
+				{ "#", Keyword::Comment },
+				{ "bevel", Keyword::Bevel },
+				{ "bmat", Keyword::Bmat },
+				{ "c_interp", Keyword::CInterp },
+				{ "con", Keyword::Con },
+				{ "cstype", Keyword::Cstype },
+				{ "ctech", Keyword::Ctech },
+				{ "curv", Keyword::Curv },
+				{ "curv2", Keyword::Curv2 },
+				{ "d_interp", Keyword::DInterp },
+				{ "deg", Keyword::Deg },
+				{ "end", Keyword::End },
+				{ "f", Keyword::F },
+				{ "g", Keyword::G },
+				{ "hole", Keyword::Hole },
+				{ "l", Keyword::L },
+				{ "lod", Keyword::Lod },
+				{ "mg", Keyword::Mg },
+				{ "mtllib", Keyword::Mtllib },
+				{ "o", Keyword::O },
+				{ "p", Keyword::P },
+				{ "parm", Keyword::Parm },
+				{ "s", Keyword::S },
+				{ "scrv", Keyword::Scrv },
+				{ "shadow_obj", Keyword::ShadowObj },
+				{ "sp", Keyword::Sp },
+				{ "stech", Keyword::Stech },
+				{ "step", Keyword::Step },
+				{ "surf", Keyword::Surf },
+				{ "trace_obj", Keyword::TraceObj },
+				{ "trim", Keyword::Trim },
+				{ "usemtl", Keyword::Usemtl },
+				{ "v", Keyword::V },
+				{ "vn", Keyword::Vn },
+				{ "vp", Keyword::Vp },
+				{ "vt", Keyword::Vt }
+			});
 		}
 
 		ObjIStream::ObjIStream(IStream* stream) : FormatIStream(stream)
@@ -91,198 +159,197 @@ namespace dsk
 					continue;
 				}
 
-				switch (hashToken(buffer))
+				const Keyword* keyword = keywords.find(std::string_view(buffer, readCount));
+				DSK_CHECK(keyword, std::format("Unrecognized start of token '{}'", std::string_view(buffer, readCount)));
+
+				switch (*keyword)
 				{
-					case hashToken("#"):
+					case Keyword::Comment:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);
 						break;
 					}
-					case hashToken("bevel"):
+					case Keyword::Bevel:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("bmat"):
+					case Keyword::Bmat:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("c_interp"):
+					case Keyword::CInterp:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("con"):
+					case Keyword::Con:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("cstype"):
+					case Keyword::Cstype:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("ctech"):
+					case Keyword::Ctech:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("curv"):
+					case Keyword::Curv:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("curv2"):
+					case Keyword::Curv2:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("d_interp"):
+					case Keyword::DInterp:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("deg"):
+					case Keyword::Deg:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("end"):
+					case Keyword::End:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("f"):
+					case Keyword::F:
 					{
 						file.faces.emplace_back();
 						DSK_CALL(_readFace, file, file.faces.back());
 						break;
 					}
-					case hashToken("g"):
+					case Keyword::G:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("hole"):
+					case Keyword::Hole:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("l"):
+					case Keyword::L:
 					{
 						file.lines.emplace_back();
 						DSK_CALL(_readLine, file, file.lines.back());
 						break;
 					}
-					case hashToken("lod"):
+					case Keyword::Lod:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("mg"):
+					case Keyword::Mg:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("mtllib"):
+					case Keyword::Mtllib:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("o"):
+					case Keyword::O:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("p"):
+					case Keyword::P:
 					{
 						file.pointClouds.emplace_back();
 						DSK_CALL(_readPointCloud, file, file.pointClouds.back());
 						break;
 					}
-					case hashToken("parm"):
+					case Keyword::Parm:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("s"):
+					case Keyword::S:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("scrv"):
+					case Keyword::Scrv:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("shadow_obj"):
+					case Keyword::ShadowObj:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("sp"):
+					case Keyword::Sp:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("stech"):
+					case Keyword::Stech:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("step"):
+					case Keyword::Step:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("surf"):
+					case Keyword::Surf:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("trace_obj"):
+					case Keyword::TraceObj:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("trim"):
+					case Keyword::Trim:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("usemtl"):
+					case Keyword::Usemtl:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("v"):
+					case Keyword::V:
 					{
 						file.positions.emplace_back();
 						DSK_CALL(_readVertexPosition, file.positions.back());
 						break;
 					}
-					case hashToken("vn"):
+					case Keyword::Vn:
 					{
 						file.normals.emplace_back();
 						DSK_CALL(_readVertexNormal, file.normals.back());
 						break;
 					}
-					case hashToken("vp"):
+					case Keyword::Vp:
 					{
 						DSKFMT_STREAM_CALL(skipCharWhile, [](char x) { return x != '\n'; }, skipCount);	// TODO
 						break;
 					}
-					case hashToken("vt"):
+					case Keyword::Vt:
 					{
 						file.texCoords.emplace_back();
 						DSK_CALL(_readVertexTextureCoordinate, file.texCoords.back());
 						break;
 					}
-					default:
-					{
-						return _status.setErrorMessage(__PRETTY_FUNCTION__, __LINE__, std::format("Unrecognized start of token '{}'", std::string_view(buffer, skipCount)));
-					}
 				}
 
 				DSKFMT_STREAM_CALL(skipCharWhile, isSpaceChar, skipCount);
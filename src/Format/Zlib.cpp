@@ -11,258 +11,323 @@ namespace dsk
 {
 	namespace fmt
 	{
-		// ZlibIStream::ZlibIStream() : FormatIStream(std::endian::big),
-		// 	_deflateStream(nullptr),
-		// 	_headerRead(false),
-		// 	_readingLastBlock(false),
-		// 	_checksum(1)
-		// {
-		// 	FMT_CREATE_SUBSTREAM(_deflateStream, DeflateIStream);
-		// 
-		// 	finishSubStreamTree();
-		// }
-		// 
-		// const ruc::Status& ZlibIStream::readFile(zlib::File& file)
-		// {
-		// 	FMT_BEGIN("ZlibIStream::readFile(zlib::File& file)");
-		// 
-		// 	file.data.clear();
-		// 
-		// 	// Read header
-		// 
-		// 	FMT_CALL(readHeader, file.header);
-		// 
-		// 	// Read data
-		// 
-		// 	constexpr uint64_t bufferSize = 1024;
-		// 	uint8_t buffer[bufferSize];
-		// 	uint64_t sizeRead;
-		// 	do {
-		// 		FMT_CALL(readData, buffer, bufferSize, sizeRead);
-		// 		file.data.insert(file.data.end(), buffer, buffer + sizeRead);
-		// 	} while (sizeRead == bufferSize);
-		// 
-		// 	// Read end
-		// 
-		// 	FMT_CALL(readEndFile);
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibIStream::readHeader(zlib::Header& header)
-		// {
-		// 	FMT_BEGIN("ZlibIStream::readHeader(zlib::Header& header)");
-		// 
-		// 	assert(!_headerRead);
-		// 
-		// 	header.dictId.reset();
-		// 
-		// 	// Read CMF & FLG bytes
-		// 
-		// 	uint16_t buffer;
-		// 	FMT_READ(buffer);
-		// 
-		// 	FMT_VERIFY(buffer % 31 == 0, ZlibInvalidFlagCheck, "Expected 2 first bytes of header to be a multiple of 31.");
-		// 	buffer >>= 5;
-		// 
-		// 	if (buffer & 1)
-		// 	{
-		// 		header.dictId.emplace();
-		// 		FMT_READ(header.dictId.value());
-		// 	}
-		// 	buffer >>= 1;
-		// 
-		// 	header.compressionLevel = static_cast<zlib::CompressionLevel>(buffer & 3);
-		// 	buffer >>= 2;
-		// 
-		// 	FMT_VERIFY((buffer & 15) == 8, ZlibInvalidCompressionMethod, "Expected compression method to be 8 (deflate). Instead, got " + std::to_string(buffer & 15) + "'.");
-		// 	header.compressionMethod = static_cast<zlib::CompressionMethod>(buffer & 15);
-		// 	buffer >>= 4;
-		// 
-		// 	header.compressionInfo = buffer;
-		// 	// TODO: Set deflate window size to 2^(header.compressionInfo + 8)
-		// 	// TODO: Verify it is less than 8
-		// 	
-		// 	// Read deflate block header
-		// 
-		// 	deflate::BlockHeader blockHeader;
-		// 	FMT_SUB_CALL(_deflateStream, readBlockHeader, blockHeader);
-		// 
-		// 	_headerRead = true;
-		// 	_readingLastBlock = blockHeader.isFinal;
-		// 	_checksum = 1;
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibIStream::readData(void* data, uint64_t size, uint64_t& sizeRead)
-		// {
-		// 	FMT_BEGIN("ZlibIStream::readData(void* data, uint64_t size, uint64_t& sizeRead)");
-		// 
-		// 	assert(_headerRead);
-		// 
-		// 	deflate::BlockHeader blockHeader;
-		// 	uint64_t blockSizeRead;
-		// 	sizeRead = 0;
-		// 
-		// 	uint8_t* it = reinterpret_cast<uint8_t*>(data);
-		// 	const uint8_t* const itEnd = it + size;
-		// 	do {
-		// 		FMT_SUB_CALL(_deflateStream, readBlockData, it, size, blockSizeRead);
-		// 		
-		// 		if (blockSizeRead == 0 && !_readingLastBlock)
-		// 		{
-		// 			FMT_SUB_CALL(_deflateStream, readBlockEnd);
-		// 			FMT_SUB_CALL(_deflateStream, readBlockHeader, blockHeader);
-		// 			FMT_SUB_CALL(_deflateStream, readBlockData, it, size, blockSizeRead);
-		// 			_readingLastBlock = blockHeader.isFinal;
-		// 		}
-		// 
-		// 		sizeRead += blockSizeRead;
-		// 		it += blockSizeRead;
-		// 		size -= blockSizeRead;
-		// 
-		// 	} while (it != itEnd && !(_readingLastBlock && blockSizeRead == 0));
-		// 
-		// 	_checksum = cksm::adler32(data, sizeRead, _checksum);
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibIStream::readEndFile()
-		// {
-		// 	FMT_BEGIN("ZlibIStream::readEndFile()");
-		// 
-		// 	assert(_readingLastBlock);
-		// 
-		// 	FMT_SUB_CALL(_deflateStream, readBlockEnd);
-		// 
-		// 	uint32_t checksum;
-		// 	FMT_READ(checksum);
-		// 	FMT_VERIFY(checksum == _checksum, ZlibInvalidChecksum, "Checksum computed and read are not equal.");
-		// 
-		// 	_headerRead = false;
-		// 	_readingLastBlock = false;
-		// 	_checksum = 1;
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// void ZlibIStream::onSourceRemoved()
-		// {
-		// 	_headerRead = false;
-		// 	_readingLastBlock = false;
-		// 	_checksum = 1;
-		// }
-		// 
-		// 
-		// ZlibOStream::ZlibOStream() : FormatOStream(std::endian::big),
-		// 	_deflateStream(nullptr),
-		// 	_headerWritten(false),
-		// 	_lastBlockHeader(),
-		// 	_checksum(1)
-		// {
-		// 	FMT_CREATE_SUBSTREAM(_deflateStream, DeflateOStream);
-		// 
-		// 	finishSubStreamTree();
-		// }
-		// 
-		// const ruc::Status& ZlibOStream::writeFile(const zlib::File& file)
-		// {
-		// 	FMT_BEGIN("ZlibOStream::writeFile(const zlib::File& file)");
-		// 
-		// 	assert(!_headerWritten);
-		// 
-		// 	// TODO: better compression
-		// 	deflate::BlockHeader blockHeader;
-		// 	blockHeader.isFinal = true;
-		// 	blockHeader.compressionType = deflate::CompressionType::FixedHuffman;
-		// 
-		// 	FMT_CALL(writeHeader, file.header, blockHeader);
-		// 	FMT_CALL(writeData, file.data.data(), file.data.size());
-		// 	FMT_CALL(writeEndFile);
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibOStream::writeHeader(const zlib::Header& header, const deflate::BlockHeader& firstBlockHeader)
-		// {
-		// 	FMT_BEGIN("ZlibOStream::writeHeader(const zlib::Header& header, const deflate::BlockHeader& firstBlockHeader)");
-		// 
-		// 	assert(!_headerWritten);
-		// 
-		// 	uint16_t buffer = 0;
-		// 
-		// 	assert(header.compressionInfo < 16);
-		// 	buffer |= header.compressionInfo;
-		// 
-		// 	buffer <<= 4;
-		// 	assert(header.compressionMethod == zlib::CompressionMethod::Deflate);
-		// 	buffer |= static_cast<uint8_t>(header.compressionMethod);
-		// 
-		// 	buffer <<= 2;
-		// 	buffer |= static_cast<uint8_t>(header.compressionLevel);
-		// 
-		// 	buffer <<= 1;
-		// 	buffer |= header.dictId.has_value() ? 1 : 0;
-		// 
-		// 	buffer <<= 5;
-		// 	buffer += 31 - (buffer % 31);
-		// 
-		// 	FMT_WRITE(buffer);
-		// 
-		// 	if (header.dictId.has_value())
-		// 	{
-		// 		FMT_WRITE(header.dictId.value());
-		// 	}
-		// 
-		// 	FMT_SUB_CALL(_deflateStream, writeBlockHeader, firstBlockHeader);
-		// 
-		// 	_headerWritten = true;
-		// 	_lastBlockHeader = firstBlockHeader;
-		// 	_checksum = 1;
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibOStream::writeData(const void* data, uint64_t size, deflate::BlockHeader* blockHeader)
-		// {
-		// 	FMT_BEGIN("ZlibOStream::writeData(const void* data, uint64_t size, deflate::BlockHeader* blockHeader)");
-		// 
-		// 	assert(_headerWritten);
-		// 	assert(!(blockHeader && _lastBlockHeader.isFinal));
-		// 
-		// 	if (blockHeader)
-		// 	{
-		// 		FMT_SUB_CALL(_deflateStream, writeBlockEnd);
-		// 		FMT_SUB_CALL(_deflateStream, writeBlockHeader, *blockHeader);
-		// 		_lastBlockHeader = *blockHeader;
-		// 	}
-		// 
-		// 	FMT_SUB_CALL(_deflateStream, writeBlockData, data, size);
-		// 
-		// 	_checksum = cksm::adler32(data, size, _checksum);
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// const ruc::Status& ZlibOStream::writeEndFile()
-		// {
-		// 	FMT_BEGIN("ZlibOStream::writeEndFile()");
-		// 
-		// 	assert(_lastBlockHeader.isFinal);
-		// 
-		// 	FMT_SUB_CALL(_deflateStream, writeBlockEnd);
-		// 	FMT_WRITE(_checksum);
-		// 
-		// 	return *_error;
-		// }
-		// 
-		// void ZlibOStream::onDestinationRemoved()
-		// {
-		// 	_headerWritten = false;
-		// 	_lastBlockHeader = deflate::BlockHeader();
-		// 	_checksum = 1;
-		// }
+		namespace
+		{
+			// The integers of the zlib format are big endian, whatever the endianness the deflate streams set
+
+			constexpr uint32_t loadBigEndian32(const uint8_t* bytes)
+			{
+				return (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+			}
+
+			constexpr void storeBigEndian32(uint32_t value, uint8_t* bytes)
+			{
+				bytes[0] = value >> 24;
+				bytes[1] = value >> 16;
+				bytes[2] = value >> 8;
+				bytes[3] = value;
+			}
+		}
+
+		ZlibIStream::ZlibIStream(IStream* stream) : FormatIStream(stream),
+			_headerRead(false),
+			_missingDictId(),
+			_readingBlock(false),
+			_readingLastBlock(false),
+			_dataEnded(false),
+			_checksum(1),
+			_deflateStream(new DeflateIStream(stream))
+		{
+			_subStreams.push_back(_deflateStream);
+		}
+
+		void ZlibIStream::readFile(zlib::File& file)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_headerRead);
+
+			file.data.clear();
+
+			// Read header
+
+			DSK_CALL(readHeader, file.header);
+			DSK_CHECK(!file.header.dictId, "The stream needs a preset dictionary, given by setDictionary between readHeader and readData.");
+
+			// Read data, directly in file.data which grows geometrically
+
+			constexpr uint64_t minDataSize = 65536;
+
+			uint64_t size = 0;
+			uint64_t sizeRead;
+			do {
+				file.data.resize(std::max<uint64_t>(2 * size, minDataSize));
+				DSK_CALL(readData, file.data.data() + size, file.data.size() - size, sizeRead);
+				size += sizeRead;
+			} while (size == file.data.size());
+
+			file.data.resize(size);
+
+			// Read end
+
+			DSK_CALL(readEndFile);
+		}
+
+		void ZlibIStream::readHeader(zlib::Header& header)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_headerRead);
+
+			// Read CMF & FLG bytes
+
+			uint8_t buffer[4];
+			DSKFMT_STREAM_CALL(read, buffer, 2);
+
+			DSK_CHECK(((buffer[0] << 8) | buffer[1]) % 31 == 0, "Expected 2 first bytes of header to be a multiple of 31.");
+			DSK_CHECK((buffer[0] & 15) == 8, std::format("Expected compression method to be 8 (deflate). Instead, got {}.", buffer[0] & 15));
+			DSK_CHECK((buffer[0] >> 4) <= 7, std::format("Expected compression info to be at most 7 (32 KiB window). Instead, got {}.", buffer[0] >> 4));
+
+			header.compressionMethod = zlib::CompressionMethod::Deflate;
+			header.compressionInfo = buffer[0] >> 4;
+			header.compressionLevel = static_cast<zlib::CompressionLevel>(buffer[1] >> 6);
+
+			header.dictId.reset();
+			if (buffer[1] & 0x20)
+			{
+				DSKFMT_STREAM_CALL(read, buffer, 4);
+				header.dictId = loadBigEndian32(buffer);
+			}
+
+			// Keep only the history the stream can reference
+
+			_deflateStream->setWindowSize(256 << header.compressionInfo);
+
+			_headerRead = true;
+			_missingDictId = header.dictId;
+			_readingBlock = false;
+			_readingLastBlock = false;
+			_dataEnded = false;
+			_checksum = 1;
+		}
+
+		void ZlibIStream::setDictionary(const uint8_t* data, uint64_t size)
+		{
+			DSKFMT_BEGIN();
+
+			assert(_headerRead);
+			assert(_missingDictId);
+
+			DSK_CHECK(adler32(data, size) == _missingDictId.value(), "The dictionary given is not the one announced by the header.");
+
+			_deflateStream->setDictionary(data, size);
+			_missingDictId.reset();
+		}
+
+		void ZlibIStream::readData(uint8_t* data, uint64_t size, uint64_t& sizeRead)
+		{
+			DSKFMT_BEGIN();
+
+			assert(_headerRead);
+			assert(!_missingDictId);
+
+			sizeRead = 0;
+			while (size && !_dataEnded)
+			{
+				if (!_readingBlock)
+				{
+					deflate::BlockHeader blockHeader;
+					DSKFMT_SUBSTREAM_CALL(_deflateStream, readBlockHeader, blockHeader);
+
+					_readingBlock = true;
+					_readingLastBlock = blockHeader.isFinal;
+				}
+
+				// The checksum is computed on the data just decoded, while it is still in cache
+
+				uint64_t blockSizeRead;
+				DSKFMT_SUBSTREAM_CALL(_deflateStream, readBlockData, data, size, blockSizeRead);
+				_checksum = adler32(data, blockSizeRead, _checksum);
+
+				data += blockSizeRead;
+				size -= blockSizeRead;
+				sizeRead += blockSizeRead;
+
+				// The block ended if it did not fill data
+
+				if (size)
+				{
+					DSKFMT_SUBSTREAM_CALL(_deflateStream, readBlockEnd);
+
+					_readingBlock = false;
+					_dataEnded = _readingLastBlock;
+				}
+			}
+		}
+
+		void ZlibIStream::readEndFile()
+		{
+			DSKFMT_BEGIN();
+
+			assert(_headerRead);
+
+			// The blocks following the data read, if any, must be empty
+
+			uint8_t byte;
+			uint64_t sizeRead;
+			DSK_CALL(readData, &byte, 1, sizeRead);
+			DSK_CHECK(sizeRead == 0, "Tried to end the file before reading all its data.");
+
+			// Read the Adler-32 checksum, which starts on the byte after the last block
+
+			uint8_t buffer[4];
+			DSKFMT_STREAM_CALL(finishByte);
+			DSKFMT_STREAM_CALL(read, buffer, 4);
+			DSK_CHECK(loadBigEndian32(buffer) == _checksum, "Checksum computed and read are not equal.");
+
+			_headerRead = false;
+			_dataEnded = false;
+			_checksum = 1;
+		}
+
+		void ZlibIStream::setStreamState()
+		{
+		}
+
+		void ZlibIStream::resetFormatState()
+		{
+			_headerRead = false;
+			_missingDictId.reset();
+			_readingBlock = false;
+			_readingLastBlock = false;
+			_dataEnded = false;
+			_checksum = 1;
+		}
+
+		ZlibIStream::~ZlibIStream()
+		{
+			delete _deflateStream;
+		}
+
+
+		ZlibOStream::ZlibOStream(OStream* stream) : FormatOStream(stream),
+			_headerWritten(false),
+			_dictId(),
+			_checksum(1),
+			_deflateStream(new DeflateOStream(stream))
+		{
+			_subStreams.push_back(_deflateStream);
+		}
+
+		void ZlibOStream::writeFile(const zlib::File& file)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_headerWritten);
+
+			DSK_CALL(writeHeader, file.header);
+			DSK_CALL(writeData, file.data.data(), file.data.size());
+			DSK_CALL(writeEndFile);
+		}
+
+		void ZlibOStream::writeHeader(const zlib::Header& header)
+		{
+			DSKFMT_BEGIN();
+
+			assert(!_headerWritten);
+			assert(header.compressionMethod == zlib::CompressionMethod::Deflate);
+			assert(header.dictId == _dictId);
+
+			// Write CMF & FLG bytes, the window of DeflateOStream being always 32 KiB
+
+			constexpr uint8_t compressionInfo = 7;
+
+			uint8_t buffer[4];
+			buffer[0] = (compressionInfo << 4) | static_cast<uint8_t>(header.compressionMethod);
+			buffer[1] = (static_cast<uint8_t>(header.compressionLevel) << 6) | (_dictId ? 0x20 : 0);
+			buffer[1] |= 31 - ((buffer[0] << 8) | buffer[1]) % 31;
+			DSKFMT_STREAM_CALL(write, buffer, 2);
+
+			if (_dictId)
+			{
+				storeBigEndian32(_dictId.value(), buffer);
+				DSKFMT_STREAM_CALL(write, buffer, 4);
+			}
+
+			// The data is written in a single final block, which DeflateOStream splits in blocks with automatic codes
+
+			deflate::BlockHeader blockHeader = {};
+			blockHeader.isFinal = true;
+			blockHeader.compressionType = deflate::CompressionType::DynamicHuffman;
+			DSKFMT_SUBSTREAM_CALL(_deflateStream, writeBlockHeader, blockHeader);
+
+			_headerWritten = true;
+			_checksum = 1;
+		}
+
+		void ZlibOStream::writeData(const uint8_t* data, uint64_t size)
+		{
+			DSKFMT_BEGIN();
+
+			assert(_headerWritten);
+
+			// The checksum is computed on the data given, while it is still in cache
+
+			_checksum = adler32(data, size, _checksum);
+			DSKFMT_SUBSTREAM_CALL(_deflateStream, writeBlockData, data, size);
+		}
+
+		void ZlibOStream::writeEndFile()
+		{
+			DSKFMT_BEGIN();
+
+			assert(_headerWritten);
+
+			// The last block ends on a byte, followed by the Adler-32 checksum
+
+			DSKFMT_SUBSTREAM_CALL(_deflateStream, writeBlockEnd);
+
+			uint8_t buffer[4];
+			storeBigEndian32(_checksum, buffer);
+			DSKFMT_STREAM_CALL(write, buffer, 4);
+
+			_headerWritten = false;
+			_dictId.reset();
+			_checksum = 1;
+		}
+
+		void ZlibOStream::setLevel(uint8_t level)
+		{
+			_deflateStream->setLevel(level);
+		}
+
+		void ZlibOStream::setStrategy(deflate::Strategy strategy)
+		{
+			_deflateStream->setStrategy(strategy);
+		}
+
+		void ZlibOStream::setDictionary(const uint8_t* data, uint64_t size)
+		{
+			assert(!_headerWritten);
+
+			_deflateStream->setDictionary(data, size);
+			_dictId = adler32(data, size);
+		}
+
+		void ZlibOStream::setStreamState()
+		{
+		}
+
+		void ZlibOStream::resetFormatState()
+		{
+			_headerWritten = false;
+			_dictId.reset();
+			_checksum = 1;
+		}
+
+		ZlibOStream::~ZlibOStream()
+		{
+			delete _deflateStream;
+		}
 	}
 }